@@ -0,0 +1,100 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Acceptor.h"
+#include "Logger.h"
+#include "InetAddress.h"
+
+static int createNonblocking()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
+    : loop_(loop)
+    , acceptSocket_(createNonblocking())
+    , acceptChannel_(loop, acceptSocket_.fd())
+    , listenning_(false)
+    , acceptBatch_(kDefaultAcceptBatch)
+    , backlog_(Socket::kDefaultBacklog)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+{
+    acceptSocket_.setReuseAddr(true);
+    acceptSocket_.setReusePort(reuseport);
+    acceptSocket_.bindAddress(listenAddr); // bind
+    // TcpServer::start() Acceptor.listen  有新用户的连接，要执行一个回调（connfd=》channel=》subloop）
+    // baseLoop => acceptChannel_(listenfd) =>
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
+Acceptor::~Acceptor()
+{
+    acceptChannel_.disableAll();
+    acceptChannel_.remove();
+    ::close(idleFd_);
+}
+
+void Acceptor::listen()
+{
+    listenning_ = true;
+    acceptSocket_.listen(backlog_); // listen
+    acceptChannel_.enableReading(); // acceptChannel_ => Poller
+}
+
+// listenfd有事件发生了，就是有新用户连接了
+void Acceptor::handleRead()
+{
+    int accepted = 0;
+    for (int i = 0; i < acceptBatch_; ++i)
+    {
+        InetAddress peerAddr(0);
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
+        {
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+                ++accepted;
+            }
+            else
+            {
+                ::close(connfd);
+            }
+            continue;
+        }
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+        {
+            break;                  // 已经取完 listen 队列
+        }
+        if (savedErrno == EMFILE)
+        {
+            // 让出预留的 fd 接受这个连接并立即关闭 对端会看到连接被关闭 而不是一直挂在 listen 队列里
+            ::close(idleFd_);
+            idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+            ::close(idleFd_);
+            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            LOG_ERROR_RATELIMITED(5, 1, "%s:%s:%d sockfd reached limit, connection shed\n", __FILE__, __FUNCTION__, __LINE__);
+            continue;
+        }
+        if (savedErrno != EINTR && savedErrno != ECONNABORTED)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+            break;
+        }
+    }
+
+    if (accepted > 0 && acceptBatchEndCallback_)
+    {
+        acceptBatchEndCallback_();
+    }
+}
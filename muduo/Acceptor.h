@@ -9,7 +9,49 @@
 class EventLoop;
 class InetAddress;
 
+/**
+ * 运行在 mainLoop 中 监听 listenfd 上的新连接
+ * 每次可读事件最多连续 accept acceptBatch_ 个连接 连接风暴时不用每个连接都回一次 poll
+ * 这一批处理完后调用 acceptBatchEndCallback_ 上层可以把这一批连接一起交给 subLoop
+ * 进程 fd 用完(EMFILE)时 先关掉预留的 idleFd_ 接受连接后马上关闭 再把 idleFd_ 占回来
+ * 否则 LT 模式下 listenfd 会一直可读 loop 空转
+ **/
 class Acceptor : noncopyable
 {
+public:
+    using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
+    using AcceptBatchEndCallback = std::function<void()>;
 
-};
\ No newline at end of file
+    static const int kDefaultAcceptBatch = 16;
+
+    Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    ~Acceptor();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    void setAcceptBatchEndCallback(const AcceptBatchEndCallback &cb) { acceptBatchEndCallback_ = cb; }
+    // listen() 之前设置 最小为 1
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+    void setBacklog(int backlog) { backlog_ = backlog; }
+
+    // listen() 之前通过它设置 listen socket 的选项
+    Socket &socket() { return acceptSocket_; }
+
+    bool listenning() const { return listenning_; }
+    void listen();
+
+    // SO_REUSEPORT 组内按 CPU 分流 见 Socket::setReusePortCpuSteering
+    bool setReusePortCpuSteering(int groupSize) { return acceptSocket_.setReusePortCpuSteering(groupSize); }
+
+private:
+    void handleRead();
+
+    EventLoop *loop_;            // Acceptor用的就是用户定义的那个baseLoop 也称作mainLoop
+    Socket acceptSocket_;
+    Channel acceptChannel_;
+    NewConnectionCallback newConnectionCallback_;
+    AcceptBatchEndCallback acceptBatchEndCallback_;
+    bool listenning_;
+    int acceptBatch_;
+    int backlog_;
+    int idleFd_;                 // 预留的 fd 用来在 EMFILE 时拒绝连接
+};
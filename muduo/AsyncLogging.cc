@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "LogStaging.h"
+#include "FixedBuffer.h"
+#include "Timestamp.h"
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval)
+    : flushInterval_(flushInterval)
+    , running_(false)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+{
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    // 在这里登记而不是在后端线程里 start() 返回后前端就可以按策略等待后端
+    if (!LogStaging::attachConsumer())
+    {
+        LOG_FATAL("AsyncLogging::start() another logging backend is already running\n");
+    }
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    if (!running_)
+    {
+        return;                          // 没有 start 或者已经 stop
+    }
+    running_ = false;
+    LogStaging::wakeConsumer();
+    thread_.join();
+    LogStaging::detachConsumer();
+}
+
+void AsyncLogging::append(const char *logline, int len, int level)
+{
+    LogStaging::appendText(level, logline, len);
+}
+
+void AsyncLogging::threadFunc()
+{
+    using Buffer = FixedBuffer<kLargeBuffer>;
+
+    LogFile output(basename_, rollSize_, flushInterval_);
+    std::unique_ptr<Buffer> buffer(new Buffer);
+
+    auto onRecord = [&](const char *record, size_t len) {
+        uint32_t type;
+        ::memcpy(&type, record, sizeof type);
+        if (type != LogStaging::kTextRecord)
+        {
+            return;                      // BinaryLogging 的记录 不会出现在这里
+        }
+        int textLen = static_cast<int>(len - LogStaging::kRecordHeaderSize);
+        if (buffer->avail() <= textLen)
+        {
+            output.append(buffer->data(), buffer->length());
+            buffer->reset();
+        }
+        buffer->append(record + LogStaging::kRecordHeaderSize, textLen);
+    };
+    // 前端产生日志的速度超过后端 暂存区满了丢掉的条数
+    auto onDropped = [&](int tid, uint64_t dropped) {
+        char buf[256];
+        int n = snprintf(buf, sizeof buf, "Dropped %lu log messages from thread %d at %s\n",
+                         dropped, tid, Timestamp::now().toFormattedString().c_str());
+        fputs(buf, stderr);
+        buffer->append(buf, n);
+    };
+
+    const auto flushInterval = std::chrono::seconds(flushInterval_);
+    auto nextFlush = std::chrono::steady_clock::now() + flushInterval;
+    for (;;)
+    {
+        bool stopping = !running_;       // 先读标志再取数据 保证退出前最后一轮取完
+        size_t records = LogStaging::drain(onRecord, onDropped);
+
+        if (buffer->length() > 0)
+        {
+            output.append(buffer->data(), buffer->length());
+            buffer->reset();
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+        // 只按 flushInterval_ flush 空闲时睡到有新记录或者下一次 flush 的时间
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextFlush)
+        {
+            output.flush();
+            nextFlush = now + flushInterval;
+        }
+        if (records == 0)
+        {
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextFlush - now);
+            LogStaging::waitForRecords(static_cast<int>(timeout.count()) + 1);
+        }
+    }
+    output.flush();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "Logger.h"
+
+/**
+ * 异步日志
+ * 前端(各个 loop 线程)append 只是把日志拷进本线程的 LogStaging 暂存区 线程之间不加锁 不会等待磁盘 IO
+ * 后端线程取出所有线程暂存区的记录 攒进一块大缓冲后写入 LogFile 每 flushInterval_ 秒 flush 一次
+ * 暂存区都空时后端睡眠 前端提交记录时唤醒
+ * 暂存区满时按日志级别丢弃或等待 见 LogStaging::setFullPolicy 丢弃的条数由后端写进日志
+ *
+ * 用法：
+ *     AsyncLogging log("server", 500 * 1000 * 1000);
+ *     log.start();
+ *     Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2, _3));
+ **/
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~AsyncLogging();
+
+    // 前端调用 线程安全
+    void append(const char *logline, int len, int level = INFO);
+
+    void start();
+    void stop();
+
+private:
+    void threadFunc();
+
+    const int flushInterval_;
+    std::atomic_bool running_;
+    const std::string basename_;
+    const off_t rollSize_;
+    Thread thread_;
+};
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <chrono>
+
+#include "BinaryLogging.h"
+#include "LogFile.h"
+#include "Logger.h"
+#include "Timestamp.h"
+#include "CurrentThread.h"
+
+std::atomic_bool BinaryLogging::enabled_(false);
+std::mutex BinaryLogging::sitesMutex_;
+std::vector<BinaryLogging::LogSite> BinaryLogging::sites_;
+
+namespace
+{
+    // 把格式串切成若干段 每段最多包含一个转换说明 返回转换说明的个数
+    int splitFormat(const char *fmt, std::vector<std::string> *fragments)
+    {
+        int conversions = 0;
+        std::string fragment;
+        const char *p = fmt;
+        while (*p)
+        {
+            if (*p != '%')
+            {
+                fragment += *p++;
+                continue;
+            }
+            if (p[1] == '%')
+            {
+                fragment += "%%";
+                p += 2;
+                continue;
+            }
+            // %[flags][width][.precision][length]conversion
+            fragment += *p++;
+            while (*p && ::strchr("-+ #0123456789.*hlLqjzt", *p))
+            {
+                fragment += *p++;
+            }
+            if (*p)
+            {
+                fragment += *p++;
+            }
+            fragments->push_back(fragment);
+            fragment.clear();
+            ++conversions;
+        }
+        fragments->push_back(fragment);
+        return conversions;
+    }
+
+    void appendFormat(std::string &output, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    void appendFormat(std::string &output, const char *fmt, ...)
+    {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        va_list retry;
+        va_copy(retry, args);
+        int n = vsnprintf(buf, sizeof buf, fmt, args);
+        if (n >= static_cast<int>(sizeof buf))
+        {
+            size_t old = output.size();
+            output.resize(old + n + 1);
+            vsnprintf(&output[old], n + 1, fmt, retry);
+            output.resize(old + n);
+        }
+        else if (n > 0)
+        {
+            output.append(buf, n);
+        }
+        va_end(retry);
+        va_end(args);
+    }
+}
+
+BinaryLogging::BinaryLogging(const std::string &basename, off_t rollSize, int flushInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , running_(false)
+    , thread_(std::bind(&BinaryLogging::threadFunc, this), "BinaryLogging")
+    , baseMicroSeconds_(0)
+    , baseCycles_(0)
+{
+}
+
+BinaryLogging::~BinaryLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void BinaryLogging::start()
+{
+    if (!LogStaging::attachConsumer())
+    {
+        LOG_FATAL("BinaryLogging::start() another logging backend is already running\n");
+    }
+    baseCycles_ = CycleClock::now();
+    baseMicroSeconds_ = Timestamp::now().microSecondsSinceEpoch();
+
+    running_ = true;
+    thread_.start();
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void BinaryLogging::stop()
+{
+    if (!running_)
+    {
+        return;                          // 没有 start 或者已经 stop
+    }
+    enabled_.store(false, std::memory_order_relaxed);
+    running_ = false;
+    LogStaging::wakeConsumer();
+    thread_.join();
+    LogStaging::detachConsumer();
+}
+
+int BinaryLogging::registerSite(int level, const char *file, int line, const char *fmt, std::vector<LogArgType> argTypes)
+{
+    LogSite site;
+    site.level = level;
+    site.file = file;
+    site.line = line;
+    site.format = fmt;
+    site.valid = splitFormat(fmt, &site.fragments) == static_cast<int>(argTypes.size());
+    site.argTypes = std::move(argTypes);
+
+    std::unique_lock<std::mutex> lock(sitesMutex_);
+    sites_.push_back(std::move(site));
+    return static_cast<int>(sites_.size() - 1);
+}
+
+void BinaryLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_);
+    std::vector<LogSite> sites;          // sites_ 的本地副本 遇到新的 siteId 再去同步
+    std::string text;
+    text.reserve(1024 * 1024);
+
+    auto onRecord = [&](const char *record, size_t len) { handleRecord(record, len, sites, text); };
+    auto onDropped = [&](int tid, uint64_t dropped) {
+        appendFormat(text, "%s%s : dropped %lu log records from thread %d\n",
+                     Logger::levelName(ERROR), Timestamp::now().toFormattedString().c_str(), dropped, tid);
+    };
+
+    const auto flushInterval = std::chrono::seconds(flushInterval_);
+    auto nextFlush = std::chrono::steady_clock::now() + flushInterval;
+    for (;;)
+    {
+        bool stopping = !running_;       // 先读标志再取数据 保证退出前最后一轮取完
+        size_t records = LogStaging::drain(onRecord, onDropped);
+
+        if (!text.empty())
+        {
+            output.append(text.data(), static_cast<int>(text.size()));
+            text.clear();
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+        // 只按 flushInterval_ flush 空闲时睡到有新记录或者下一次 flush 的时间
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextFlush)
+        {
+            output.flush();
+            nextFlush = now + flushInterval;
+        }
+        if (records == 0)
+        {
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextFlush - now);
+            LogStaging::waitForRecords(static_cast<int>(timeout.count()) + 1);
+        }
+    }
+    output.flush();
+}
+
+void BinaryLogging::handleRecord(const char *record, size_t len, std::vector<LogSite> &sites, std::string &output)
+{
+    uint32_t id;
+    ::memcpy(&id, record, sizeof id);
+    if (id == LogStaging::kTextRecord)
+    {
+        output.append(record + LogStaging::kRecordHeaderSize, len - LogStaging::kRecordHeaderSize);
+        return;
+    }
+    if (id >= sites.size())
+    {
+        std::unique_lock<std::mutex> lock(sitesMutex_);
+        sites = sites_;
+    }
+    formatRecord(sites[id], record, len, output);
+}
+
+void BinaryLogging::formatRecord(const LogSite &site, const char *record, size_t len, std::string &output)
+{
+    uint64_t cycles;
+    ::memcpy(&cycles, record + LogStaging::kRecordHeaderSize, sizeof cycles);
+    double elapsedNs = static_cast<double>(static_cast<int64_t>(cycles - baseCycles_)) / CycleClock::cyclesPerNanoSecond();
+    Timestamp time(baseMicroSeconds_ + static_cast<int64_t>(elapsedNs / 1000));
+
+    char prefix[64];
+    const char *level = Logger::levelName(site.level);
+    size_t levelLen = ::strlen(level);
+    ::memcpy(prefix, level, levelLen);
+    int prefixLen = static_cast<int>(levelLen) + time.formatTo(prefix + levelLen);
+    output.append(prefix, prefixLen);
+    output.append(" : ", 3);
+
+    if (!site.valid)       // 参数个数对不上 原样输出格式串
+    {
+        appendFormat(output, "<format mismatch %s:%d> %s", site.file, site.line, site.format);
+        if (output[output.size() - 1] != '\n')
+        {
+            output += '\n';
+        }
+        return;
+    }
+
+    const char *p = record + kRecordHeaderSize;
+    const char *end = record + len;
+    for (size_t i = 0; i < site.fragments.size(); ++i)
+    {
+        const char *fragment = site.fragments[i].c_str();
+        if (i >= site.argTypes.size())
+        {
+            appendFormat(output, fragment, 0);        // 只剩普通文本(或 %% )
+            continue;
+        }
+        switch (site.argTypes[i])
+        {
+        case kLogArgInt32:
+        {
+            int32_t v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, v);
+            break;
+        }
+        case kLogArgUInt32:
+        {
+            uint32_t v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, v);
+            break;
+        }
+        case kLogArgInt64:
+        {
+            int64_t v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, v);
+            break;
+        }
+        case kLogArgUInt64:
+        {
+            uint64_t v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, v);
+            break;
+        }
+        case kLogArgDouble:
+        {
+            double v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, v);
+            break;
+        }
+        case kLogArgString:
+        {
+            uint32_t n;
+            ::memcpy(&n, p, sizeof n);
+            std::string v(p + sizeof n, n);
+            p += sizeof n + n;
+            appendFormat(output, fragment, v.c_str());
+            break;
+        }
+        case kLogArgPointer:
+        {
+            uint64_t v;
+            ::memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            appendFormat(output, fragment, reinterpret_cast<void *>(v));
+            break;
+        }
+        }
+        if (p > end)
+        {
+            break;
+        }
+    }
+
+    if (output[output.size() - 1] != '\n')
+    {
+        output += '\n';
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <stdint.h>
+#include <string.h>
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "CycleClock.h"
+#include "LogStaging.h"
+
+/**
+ * 延迟格式化的二进制日志(NanoLog 的思路)
+ * 每个 LOG_* 调用点第一次执行时把格式串和参数类型登记一次 得到 siteId 保存在调用点的静态变量里
+ * 之后每次调用只把 siteId 时间戳(CycleClock)和参数的原始字节拷进本线程的 LogStaging 暂存区 不做 snprintf
+ * 后端线程轮询所有线程的暂存区 按登记的格式串格式化后写入 LogFile 暂存区里的文本记录原样写入
+ *
+ * 用法：
+ *     BinaryLogging log("trace", 500 * 1000 * 1000);
+ *     log.start();      // 之后 LOG_INFO/LOG_ERROR/LOG_DEBUG 都走这里
+ **/
+
+enum LogArgType : uint8_t
+{
+    kLogArgInt32,
+    kLogArgUInt32,
+    kLogArgInt64,
+    kLogArgUInt64,
+    kLogArgDouble,
+    kLogArgString,      // const char* 拷贝字符串内容 4 字节长度 + 内容
+    kLogArgPointer,
+};
+
+namespace detail
+{
+    template <typename T, typename Enable = void>
+    struct LogArg;
+
+    // 整数和枚举 按大小和符号存成 32/64 位 传给 printf 时与默认实参提升后的类型一致
+    template <typename T>
+    struct LogArg<T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+    {
+        static const bool kSigned = std::is_signed<T>::value || std::is_enum<T>::value;
+        using Stored = typename std::conditional<(sizeof(T) > 4),
+                                                 typename std::conditional<kSigned, int64_t, uint64_t>::type,
+                                                 typename std::conditional<kSigned, int32_t, uint32_t>::type>::type;
+
+        static LogArgType type()
+        {
+            return sizeof(Stored) == 8 ? (kSigned ? kLogArgInt64 : kLogArgUInt64) : (kSigned ? kLogArgInt32 : kLogArgUInt32);
+        }
+        static size_t size(T) { return sizeof(Stored); }
+        static char *write(char *p, T v)
+        {
+            Stored stored = static_cast<Stored>(v);
+            ::memcpy(p, &stored, sizeof stored);
+            return p + sizeof stored;
+        }
+    };
+
+    template <typename T>
+    struct LogArg<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static LogArgType type() { return kLogArgDouble; }
+        static size_t size(T) { return sizeof(double); }
+        static char *write(char *p, T v)
+        {
+            double stored = static_cast<double>(v);
+            ::memcpy(p, &stored, sizeof stored);
+            return p + sizeof stored;
+        }
+    };
+
+    template <typename T>
+    struct IsCharPointer
+        : std::integral_constant<bool, std::is_pointer<T>::value &&
+                                           std::is_same<typename std::remove_cv<typename std::remove_pointer<T>::type>::type, char>::value>
+    {
+    };
+
+    // 字符串在调用返回后可能失效 必须拷贝内容
+    template <typename T>
+    struct LogArg<T, typename std::enable_if<IsCharPointer<T>::value>::type>
+    {
+        static LogArgType type() { return kLogArgString; }
+        static size_t size(T v) { return sizeof(uint32_t) + (v ? ::strlen(v) : 6); }
+        static char *write(char *p, T v)
+        {
+            const char *str = v ? v : "(null)";
+            uint32_t len = static_cast<uint32_t>(::strlen(str));
+            ::memcpy(p, &len, sizeof len);
+            ::memcpy(p + sizeof len, str, len);
+            return p + sizeof len + len;
+        }
+    };
+
+    template <typename T>
+    struct LogArg<T, typename std::enable_if<std::is_pointer<T>::value && !IsCharPointer<T>::value>::type>
+    {
+        static LogArgType type() { return kLogArgPointer; }
+        static size_t size(T) { return sizeof(uint64_t); }
+        static char *write(char *p, T v)
+        {
+            uint64_t stored = reinterpret_cast<uintptr_t>(v);
+            ::memcpy(p, &stored, sizeof stored);
+            return p + sizeof stored;
+        }
+    };
+
+    inline size_t logArgsSize() { return 0; }
+
+    template <typename T, typename... Rest>
+    size_t logArgsSize(T v, Rest... rest) { return LogArg<T>::size(v) + logArgsSize(rest...); }
+
+    inline char *writeLogArgs(char *p) { return p; }
+
+    template <typename T, typename... Rest>
+    char *writeLogArgs(char *p, T v, Rest... rest) { return writeLogArgs(LogArg<T>::write(p, v), rest...); }
+
+    template <typename... Args>
+    std::vector<LogArgType> logArgTypes() { return std::vector<LogArgType>{LogArg<Args>::type()...}; }
+}
+
+class BinaryLogging : noncopyable
+{
+public:
+    BinaryLogging(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~BinaryLogging();
+
+    void start();
+    void stop();
+
+    // LOG_* 宏据此决定走二进制日志还是 Logger
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    template <typename... Args>
+    static void log(std::atomic<int> &siteId, int level, const char *file, int line, const char *fmt, Args... args)
+    {
+        int id = siteId.load(std::memory_order_relaxed);
+        if (__builtin_expect(id < 0, 0))
+        {
+            id = registerSite(level, file, line, fmt, detail::logArgTypes<Args...>());
+            siteId.store(id, std::memory_order_relaxed);
+        }
+
+        size_t len = kRecordHeaderSize + detail::logArgsSize(args...);
+        char *p = LogStaging::reserve(level, len);
+        if (p == nullptr)
+        {
+            return;                     // 按 level 的策略丢弃 已计数
+        }
+        uint32_t header[2] = {static_cast<uint32_t>(id), 0};
+        uint64_t cycles = CycleClock::now();
+        ::memcpy(p, header, sizeof header);
+        ::memcpy(p + sizeof header, &cycles, sizeof cycles);
+        detail::writeLogArgs(p + kRecordHeaderSize, args...);
+        LogStaging::commit();
+    }
+
+private:
+    struct LogSite
+    {
+        int level;
+        const char *file;
+        int line;
+        const char *format;
+        std::vector<std::string> fragments;     // 每段最多一个转换说明 最后一段是结尾的普通文本
+        std::vector<LogArgType> argTypes;
+        bool valid;                             // 转换说明的个数与参数个数一致
+    };
+
+    static const size_t kRecordHeaderSize = LogStaging::kRecordHeaderSize + 8;  // siteId + 填充 + CycleClock
+
+    static int registerSite(int level, const char *file, int line, const char *fmt, std::vector<LogArgType> argTypes);
+
+    void threadFunc();
+    void handleRecord(const char *record, size_t len, std::vector<LogSite> &sites, std::string &output);
+    void formatRecord(const LogSite &site, const char *record, size_t len, std::string &output);
+
+    static std::atomic_bool enabled_;
+    static std::mutex sitesMutex_;
+    static std::vector<LogSite> sites_;
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    std::atomic_bool running_;
+    Thread thread_;
+
+    // 把 CycleClock 换算成墙上时间的基准
+    int64_t baseMicroSeconds_;
+    uint64_t baseCycles_;
+};
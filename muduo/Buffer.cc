@@ -0,0 +1,54 @@
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Buffer.h"
+
+/**
+ * 从fd上读取数据  Poller工作在LT模式
+ * Buffer缓冲区是有大小的 但是从fd上读数据的时候 却不知道tcp数据最终的大小
+ * 用 readv 同时读进 Buffer 的可写空间和栈上的 64K extrabuf 一次系统调用就能读完一大块
+ * 每个连接的 Buffer 可以从很小开始 只有真的读到了那么多数据才扩容
+ **/
+ssize_t Buffer::readFd(int fd, int *saveErrno)
+{
+    char extrabuf[65536];        // 栈上的内存空间  64K 不清零 只用 readv 写进去的部分
+
+    struct iovec vec[2];
+
+    const size_t writable = writableBytes(); // 这是Buffer底层缓冲区剩余的可写空间大小
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    // 可写空间已经不小于 extrabuf 就不用它了 一次最多读 64K
+    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (static_cast<size_t>(n) <= writable)   // Buffer的可写缓冲区已经够存储读出来的数据了
+    {
+        writerIndex_ += n;
+    }
+    else                         // extrabuf里面也写入了数据
+    {
+        writerIndex_ = buffer_.size();
+        append(extrabuf, n - writable);  // writerIndex_开始写 n - writable大小的数据
+    }
+
+    return n;
+}
+
+ssize_t Buffer::writeFd(int fd, int *saveErrno)
+{
+    ssize_t n = ::write(fd, peek(), readableBytes());
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * 网络库底层的缓冲区类型定义
+ *
+ * +-------------------+------------------+------------------+
+ * | prependable bytes |  readable bytes  |  writable bytes  |
+ * |                   |     (CONTENT)    |                  |
+ * +-------------------+------------------+------------------+
+ * |                   |                  |                  |
+ * 0      <=      readerIndex   <=   writerIndex    <=     size
+ *
+ * 前面预留 kCheapPrepend 字节 序列化好消息后可以直接在数据前面填长度头 不用挪动数据
+ **/
+class Buffer
+{
+public:
+    static const size_t kCheapPrepend = 8;
+    static const size_t kInitialSize = 1024;
+
+    explicit Buffer(size_t initialSize = kInitialSize)
+        : buffer_(kCheapPrepend + initialSize)
+        , readerIndex_(kCheapPrepend)
+        , writerIndex_(kCheapPrepend)
+    {}
+
+    size_t readableBytes() const { return writerIndex_ - readerIndex_; }
+    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t prependableBytes() const { return readerIndex_; }
+
+    // 返回缓冲区中可读数据的起始地址
+    const char *peek() const { return begin() + readerIndex_; }
+
+    // onMessage string <- Buffer
+    void retrieve(size_t len)
+    {
+        if (len < readableBytes())
+        {
+            readerIndex_ += len;     // 应用只读取了可读缓冲区数据的一部分 就是len 还剩下readerIndex_ += len -> writerIndex_
+        }
+        else                         // len == readableBytes()
+        {
+            retrieveAll();
+        }
+    }
+
+    void retrieveAll()
+    {
+        readerIndex_ = writerIndex_ = kCheapPrepend;
+    }
+
+    // 把onMessage函数上报的Buffer数据 转成string类型的数据返回
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+
+    std::string retrieveAsString(size_t len)
+    {
+        std::string result(peek(), len);
+        retrieve(len);               // 上面一句把缓冲区中可读的数据 已经读取出来 这里肯定要对缓冲区进行复位操作
+        return result;
+    }
+
+    // buffer_.size() - writerIndex_    len
+    void ensureWriteableBytes(size_t len)
+    {
+        if (writableBytes() < len)
+        {
+            makeSpace(len);          // 扩容函数
+        }
+    }
+
+    // 把[data, data+len]内存上的数据 添加到writable缓冲区当中
+    void append(const char *data, size_t len)
+    {
+        ensureWriteableBytes(len);
+        std::copy(data, data + len, beginWrite());
+        writerIndex_ += len;
+    }
+
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    char *beginWrite() { return begin() + writerIndex_; }
+    const char *beginWrite() const { return begin() + writerIndex_; }
+
+    // 写入 beginWrite() 之后调用
+    void hasWritten(size_t len) { writerIndex_ += len; }
+
+    // 在可读数据前面填入 len 字节 比如消息的长度头 不能超过 prependableBytes()
+    void prepend(const void *data, size_t len)
+    {
+        assert(len <= prependableBytes());
+        readerIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+
+    // 连接空闲时把大块的缓冲区还回去 只保留可读数据加上 reserve 字节
+    void shrink(size_t reserve)
+    {
+        Buffer other(readableBytes() + reserve);
+        other.append(peek(), readableBytes());
+        swap(other);
+    }
+
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
+    size_t internalCapacity() const { return buffer_.capacity(); }
+
+    // 从fd上读取数据
+    ssize_t readFd(int fd, int *saveErrno);
+    // 通过fd发送数据
+    ssize_t writeFd(int fd, int *saveErrno);
+
+private:
+    char *begin() { return &*buffer_.begin(); }              // vector底层数组首元素的地址 也就是数组的起始地址
+    const char *begin() const { return &*buffer_.begin(); }
+
+    void makeSpace(size_t len)
+    {
+        // 前面空出来的加上后面可写的也不够 只能扩容
+        if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+        {
+            buffer_.resize(writerIndex_ + len);
+        }
+        else                         // 把可读数据挪到前面 复用已经读走的空间
+        {
+            size_t readable = readableBytes();
+            std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
+            readerIndex_ = kCheapPrepend;
+            writerIndex_ = readerIndex_ + readable;
+        }
+    }
+
+    std::vector<char> buffer_;
+    size_t readerIndex_;
+    size_t writerIndex_;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+
+class Buffer;
+class TcpConnection;
+class Timestamp;
+
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
+using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
+using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
+// 发送缓冲积压到 highWaterMark 时调用 一般在这里暂停读上游 等 WriteCompleteCallback 再恢复
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+// TcpConnection::migrateTo 完成后在新 loop 线程中调用
+using MigratedCallback = std::function<void(const TcpConnectionPtr &)>;
@@ -0,0 +1,100 @@
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "ChainBuffer.h"
+
+ChainBuffer::ChainBuffer()
+    : readable_(0)
+    , bytesCopied_(0)
+{
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    bytesCopied_ += len;
+    readable_ += len;
+
+    // 尾部自有块还放得下 直接追加 不会重新分配 已有分片的偏移都不变
+    if (tail_ && tail_->capacity() - tail_->size() >= len)
+    {
+        tail_->append(data, len);
+        slices_.back().length += len;
+        return;
+    }
+
+    tail_ = std::make_shared<std::string>();
+    tail_->reserve(len > kBlockSize ? len : kBlockSize);
+    tail_->append(data, len);
+    slices_.push_back(Slice{tail_, 0, len});
+}
+
+void ChainBuffer::append(const Block &block, size_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    readable_ += len;
+    slices_.push_back(Slice{block, offset, len});
+    tail_.reset();               // 后面再拷贝的数据要排在这个分片之后
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    if (len >= readable_)
+    {
+        retrieveAll();
+        return;
+    }
+    readable_ -= len;
+    while (len > 0)
+    {
+        Slice &front = slices_.front();
+        if (len < front.length)  // 写了一部分
+        {
+            front.offset += len;
+            front.length -= len;
+            break;
+        }
+        len -= front.length;
+        if (slices_.size() == 1)
+        {
+            tail_.reset();
+        }
+        slices_.pop_front();
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    slices_.clear();
+    tail_.reset();
+    readable_ = 0;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *saveErrno)
+{
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (auto it = slices_.begin(); it != slices_.end() && iovcnt < IOV_MAX; ++it, ++iovcnt)
+    {
+        vec[iovcnt].iov_base = const_cast<char *>(it->block->data() + it->offset);
+        vec[iovcnt].iov_len = it->length;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else
+    {
+        retrieve(n);
+    }
+    return n;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+/**
+ * 由多个分片组成的发送缓冲 一个响应由好几块拼成时(头部 缓存的正文 尾部)不需要拷进一块连续内存
+ * 每个分片引用一块共享的只读数据 Block 加上偏移和长度 缓存的正文可以被很多连接同时引用
+ * 零碎的小块数据拷进缓冲自己的块里 相邻的小块合并成一个分片
+ * writeFd 用一次 writev 写出最多 IOV_MAX 个分片 短写时正确推进写了一部分的分片
+ * 拼好的响应交给 TcpConnection::send(ChainBuffer *) 发送 连接把整条链排进发送队列 不拷贝引用的块
+ **/
+class ChainBuffer : noncopyable
+{
+public:
+    using Block = std::shared_ptr<const std::string>;
+
+    ChainBuffer();
+
+    // 拷贝 小块追加进尾部自己的块
+    void append(const char *data, size_t len);
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    // 引用 不拷贝 block 在写出之前不能被修改
+    void append(const Block &block) { append(block, 0, block->size()); }
+    void append(const Block &block, size_t offset, size_t len);
+
+    size_t readableBytes() const { return readable_; }
+    size_t sliceCount() const { return slices_.size(); }
+
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    void swap(ChainBuffer &rhs)
+    {
+        slices_.swap(rhs.slices_);
+        tail_.swap(rhs.tail_);
+        std::swap(readable_, rhs.readable_);
+        std::swap(bytesCopied_, rhs.bytesCopied_);
+    }
+
+    // 通过fd发送数据
+    ssize_t writeFd(int fd, int *saveErrno);
+
+    // 追加时拷贝过的字节数 用来评估省下的内存带宽
+    size_t bytesCopied() const { return bytesCopied_; }
+
+private:
+    static const size_t kBlockSize = 4096;   // 自有块的大小 超过它的数据单独一块
+
+    struct Slice
+    {
+        Block block;
+        size_t offset;
+        size_t length;
+    };
+
+    std::deque<Slice> slices_;
+    std::shared_ptr<std::string> tail_;      // 最后一个分片是自有块时指向它 还能继续追加
+    size_t readable_;
+    size_t bytesCopied_;
+};
@@ -63,6 +63,37 @@ void Channel::remove()
     loop_->removeChannel(this);
 }
 
+void Channel::moveToLoop(EventLoop *targetLoop, EventCallback movedCb)
+{
+    std::shared_ptr<void> guard;      // 迁移期间保证 tie 的对象(TcpConnection)存活
+    if(tied_)
+    {
+        guard = tie_.lock();
+    }
+
+    // 放在 pendingFunctors 中执行 此时本轮 activeChannels_ 已经处理完 源 loop 不会再回调这个 channel
+    loop_->queueInLoop([this, targetLoop, movedCb, guard]() {
+        int events = events_;
+        if(loop_->hasChannel(this))
+        {
+            disableAll();
+            remove();
+        }
+        loop_ = targetLoop;
+        targetLoop->queueInLoop([this, events, movedCb, guard]() {
+            events_ = events;
+            if(!isNoneEvent())
+            {
+                update();
+            }
+            if(movedCb)
+            {
+                movedCb();
+            }
+        });
+    });
+}
+
 // fd 得到 Poller 通知以后，处理事件 handleEvent ,在 EventLoop::loop()中调用 
 void Channel::handleEvent(Timestamp receiveTime)
 {
@@ -90,7 +121,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 */
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_DEBUG_SAMPLED(100, "channel handleEvent revents:%d\n", revents_);
     
     if((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -45,7 +45,7 @@ public:
     int events()         const {return events_;}
     // 为什么要设置这样一个方法？
     // channel 不能监听自己发生了什么事件，poller在监听
-    int set_revents(int revt)  {revents_ = revt;}
+    void set_revents(int revt) {revents_ = revt;}
 
     // 设置fd相应的事件状态 相当于 epoll_ctl add delete
     /*
@@ -72,6 +72,14 @@ public:
     EventLoop *ownerLoop() { return loop_; }
     void remove();   // 删除 channel
 
+    /**
+     * 把 channel 迁移到 targetLoop 在 ownerLoop 线程中调用
+     * 源 loop 在 pendingFunctors 中把 channel 从 Poller 注销 再通过 queueInLoop 交给 targetLoop 按原来的 events 重新注册
+     * 注册完成后在 targetLoop 线程中调用 movedCb 拥有 channel 的对象在这里更新自己的 loop 指针
+     * epoll 是 LT 模式 迁移期间到达的数据仍留在内核缓冲区里 重新注册后会再次上报
+     **/
+    void moveToLoop(EventLoop *targetLoop, EventCallback movedCb);
+
 private:
     void update(); 
     // WithGuard 受保护的
@@ -5,7 +5,7 @@
 
 namespace CurrentThread
 {
-    __thread int t_cachedTid = 0;                   // 保存tid缓存 因为系统调用非常耗时 拿到tid后将其保存
+    extern __thread int t_cachedTid;                // 保存tid缓存 因为系统调用非常耗时 拿到tid后将其保存
 
     void cacheTid();
 
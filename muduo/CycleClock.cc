@@ -0,0 +1,42 @@
+#include "CycleClock.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// 按定义顺序初始化 校准时 useTsc_ 已经确定
+const bool CycleClock::useTsc_ = CycleClock::detectInvariantTsc();
+const double CycleClock::cyclesPerNanoSecond_ = CycleClock::calibrate();
+
+// CPUID.80000007H:EDX[8] 表示 TSC 以恒定频率运行 不受变频和 C-state 影响
+bool CycleClock::detectInvariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) && eax >= 0x80000007)
+    {
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }
+#endif
+    return false;
+}
+
+double CycleClock::calibrate()
+{
+    if (!useTsc_)
+    {
+        return 1.0;
+    }
+
+    const uint64_t kCalibrateNanoSeconds = 10 * 1000 * 1000;
+    uint64_t startNs = monotonicNanoSeconds();
+    uint64_t startCycles = now();
+    uint64_t endNs = startNs;
+    while (endNs - startNs < kCalibrateNanoSeconds)
+    {
+        endNs = monotonicNanoSeconds();
+    }
+    uint64_t endCycles = now();
+    return static_cast<double>(endCycles - startCycles) / static_cast<double>(endNs - startNs);
+}
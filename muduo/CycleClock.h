@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * 基于 TSC 的周期时钟 用于热路径上的计时(每个事件 每轮循环)
+ * now() 只是一条 rdtsc 指令 比 clock_gettime 便宜一个数量级 只能用来计算时间差 不是墙上时间
+ * CPU 没有 invariant TSC(或不是 x86)时退化为 CLOCK_MONOTONIC 的纳秒数
+ * 周期与时间的换算比例在库加载时(静态初始化)对照 CLOCK_MONOTONIC 校准一次 约 10ms 之后的换算不会阻塞
+ **/
+class CycleClock
+{
+public:
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (useTsc_)
+        {
+            return __rdtsc();
+        }
+#endif
+        return monotonicNanoSeconds();
+    }
+
+    static bool usingTsc() { return useTsc_; }
+
+    // 换算 不要在其他编译单元的静态初始化中调用 那时可能还没校准
+    static double cyclesPerNanoSecond() { return cyclesPerNanoSecond_; }
+    static int64_t toNanoSeconds(uint64_t cycles) { return static_cast<int64_t>(cycles / cyclesPerNanoSecond_); }
+    static int64_t toMicroSeconds(uint64_t cycles) { return static_cast<int64_t>(cycles / cyclesPerNanoSecond_ / 1000); }
+    static uint64_t fromSeconds(double seconds) { return static_cast<uint64_t>(seconds * 1e9 * cyclesPerNanoSecond_); }
+
+    static uint64_t monotonicNanoSeconds()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+    }
+
+private:
+    static bool detectInvariantTsc();
+    static double calibrate();
+
+    static const bool useTsc_;
+    static const double cyclesPerNanoSecond_;
+};
@@ -29,7 +29,8 @@ EPollPoller::~EPollPoller()
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // 由于频繁调用poll 实际上应该用LOG_DEBUG输出日志更为合理 当遇到并发场景 关闭DEBUG日志提升效率
-    LOG_INFO("func=%s => fd total count:%lu\n", __FUNCTION__, channels_.size());
+    // 打开 DEBUG 时也只采样输出 每轮都打会拖慢 loop
+    LOG_DEBUG_SAMPLED(100, "func=%s => fd total count:%lu\n", __FUNCTION__, channels_.size());
 
     // using EPollPoller::EventList = std::vector<epoll_event> 
     // EPollPoller::EventList EPollPoller::events_
@@ -40,7 +41,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
     // 有发生事件的 fd
     if (numEvents > 0)  
     {
-        LOG_INFO("%d events happend\n", numEvents);     // LOG_DEBUG最合理
+        LOG_DEBUG_SAMPLED(100, "%d events happend\n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size())                // 扩容操作
         {
@@ -56,7 +57,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
         if (saveErrno != EINTR)      // 不是中断
         {
             errno = saveErrno;        // 更新错误
-            LOG_ERROR("EPollPoller::poll() error!");
+            LOG_ERROR_RATELIMITED(5, 1, "EPollPoller::poll() error:%d\n", saveErrno);
         }
     }
     return now;
@@ -73,7 +74,7 @@ void EPollPoller::updateChannel(Channel *channel)
 {
     // index 初始化为-1 kNew
     const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
 
     /*
         // 三种 channel 状态
@@ -117,7 +118,7 @@ void EPollPoller::removeChannel(Channel *channel)
     // 取得 fd
     int fd = channel->fd();
 
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
 
     int index = channel->index();
     channels_.erase(fd);
@@ -169,10 +170,13 @@ void EPollPoller::update(int operation, Channel *channel)
 
     if(::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
-        LOG_ERROR("epoll_ctl del error:%d\n", errno);
-    }  
-    else
-    {
-        LOG_FATAL("epoll_ctl add/mod error:%d\n", errno);
+        if(operation == EPOLL_CTL_DEL)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "epoll_ctl del error:%d\n", errno);
+        }
+        else
+        {
+            LOG_FATAL("epoll_ctl add/mod error:%d\n", errno);
+        }
     }
 }
@@ -9,6 +9,8 @@
 #include "Channel.h"
 #include "Poller.h"
 #include "CurrentThread.h"
+#include "Rcu.h"
+#include "CycleClock.h"
 
 // 全局， 防止一个线程创建多个EventLoop
 __thread EventLoop* t_loopInThisThread = nullptr;
@@ -16,6 +18,9 @@ __thread EventLoop* t_loopInThisThread = nullptr;
 // 定义默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000; // 10000毫秒 = 10秒钟
 
+// 每一对 loop 之间 SPSC 队列的容量
+const size_t kShardQueueSize = 4096;
+
 /* 创建线程之后主线程和子线程谁先运行是不确定的。
  * 通过一个eventfd在线程之间传递数据的好处是多个线程无需上锁就可以实现同步。
  * eventfd支持的最低内核版本为Linux 2.6.27,在2.6.26及之前的版本也可以使用eventfd，但是flags必须设置为0。
@@ -33,6 +38,40 @@ const int kPollTimeMs = 10000; // 10000毫秒 = 10秒钟
  */
 
 // 创建wakeupfd 用来 notify 唤醒 subReactor 处理新来的 channel
+int createEventfd();
+
+struct EventLoop::ShardEndpoint
+{
+    ShardEndpoint() : wakeupFd(createEventfd()), sleeping(false), hasNewInboxes(false) {}
+    ~ShardEndpoint() { ::close(wakeupFd); }
+
+    void wakeup()
+    {
+        uint64_t one = 1;
+        ssize_t n = ::write(wakeupFd, &one, sizeof one);
+        if(n != sizeof one)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "EventLoop::wakeup() writes %ld bytes instead of 8\n", n);
+        }
+    }
+
+    const int wakeupFd;
+    std::atomic_bool sleeping;                 // 本 loop 即将阻塞在 poll 上 生产者据此决定是否 wakeup
+    std::mutex mutex;
+    std::vector<Inbox> newInboxes;             // 其他 loop 新建的队列 下一轮 doShardFunctors 取走
+    std::atomic_bool hasNewInboxes;
+};
+
+namespace
+{
+    // 两个 weak_ptr 是否指向同一个对象 只比较控制块 不改引用计数 对象已经析构也能比较
+    template <typename T>
+    bool sameOwner(const std::weak_ptr<T> &a, const std::shared_ptr<T> &b)
+    {
+        return !a.owner_before(b) && !b.owner_before(a);
+    }
+}
+
 int createEventfd()
 {
     int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
@@ -47,10 +86,13 @@ EventLoop::EventLoop() :looping_(false),
                         quit_(false),
                         callingPendingFunctors_(false),
                         threadId_(CurrentThread::tid()),
+                        busyCycles_(0),
                         poller_(Poller::newDefaultPoller(this)),
-                        wakeupFd_(createEventfd()),
+                        endpoint_(std::make_shared<ShardEndpoint>()),
+                        wakeupFd_(endpoint_->wakeupFd),
                         wakeupChannel_(new Channel(this, wakeupFd_)),    // 只注册了 wakeupFd_， 没有设置感兴趣的事件
-                        currentActiveChannel_(nullptr)
+                        currentActiveChannel_(nullptr),
+                        quiescentState_(1)
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, threadId_);
     if(t_loopInThisThread)  // 不为空
@@ -65,13 +107,16 @@ EventLoop::EventLoop() :looping_(false),
     // std::unique_ptr<Channel> EventLoop::wakeupChannel_
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));    // 设置 wakeupfd 的事件类型以及发生事件后的回调操作
     wakeupChannel_->enableReading();                                             // 每一个EventLoop都将监听wakeupChannel_的EPOLL读事件了
+
+    RcuDomain::instance().registerLoop(this, &quiescentState_);
 }
 
 EventLoop::~EventLoop()
 {
+    RcuDomain::instance().unregisterLoop(this);
     wakeupChannel_->disableAll();     // 给Channel移除所有感兴趣的事件
     wakeupChannel_->remove();         // 把Channel从EventLoop上删除掉
-    ::close(wakeupFd_);
+    // wakeupFd_ 由 endpoint_ 关闭 其他 loop 可能正拿着它 wakeup
     t_loopInThisThread = nullptr;
 }
 
@@ -83,11 +128,25 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping\n", this);
 
+    quiescentState_.store(quiescentState_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);   // 上线
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
     while (!quit_)
     {
         activeChannels_.clear();
         // 监听两类 fd， 一种是 wakeup, 一种是client的fd
-        pollRetureTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        int timeoutMs = pollTimeoutMs();
+        // 本轮循环结束 进入 RCU 静止状态 之前读到的 Shared<T> 快照不再使用
+        quiescentState_.store(quiescentState_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        // 阻塞之前回收已经过了宽限期的旧版本 最后一个经过静止点的 loop 会在这里释放 不会一直等到下一个事件
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        RcuDomain::instance().quiescent();
+        pollRetureTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        Timestamp::setCachedNow(pollRetureTime_);
+        endpoint_->sleeping.store(false, std::memory_order_relaxed);
+        quiescentState_.store(quiescentState_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);     // 上线之后的读取不能提前到计数器更新之前
+        uint64_t busyStart = CycleClock::now();
         for (Channel *channel : activeChannels_)
         {
             // Poller 监听哪些 channel 发生了事件 然后上报给 EventLoop 通知 channel 处理相应的事件
@@ -99,9 +158,16 @@ void EventLoop::loop()
          *
          * mainloop 调用 queueInLoop 将回调 cb 加入 subloop（该回调需要 subloop 执行 但 subloop 还在 poller_->poll处阻塞） queueInLoop 通过 wakeup 将 subloop 唤醒
          **/
+        // 先处理其他 loop 经 SPSC 队列发来的回调 它们 queueInLoop 的回调本轮就能执行
+        doShardFunctors();
         // std::vector<Functor> pendingFunctors_;    // 存储 loop 需要执行的所有回调操作
         doPendingFunctors();
+        // 本轮产生的写操作合并到这里统一写出
+        doIterationEndFunctors();
+        busyCycles_.store(busyCycles_.load(std::memory_order_relaxed) + CycleClock::now() - busyStart,
+                          std::memory_order_relaxed);
     }
+    quiescentState_.store(quiescentState_.load(std::memory_order_relaxed) + 1, std::memory_order_release);   // 离线
     LOG_INFO("EventLoop %p stop looping.\n", this);
     looping_ = false;
 }
@@ -128,9 +194,13 @@ void EventLoop::quit()
 
 void EventLoop::runInLoop(Functor cb)
 {
-    if (!isInLoopThread())
+    if (isInLoopThread())       // 在当前的loop线程中 直接执行回调
     {
-        wakeup();
+        cb();
+    }
+    else                        // 在非当前loop线程中执行cb 就需要唤醒loop所在线程执行cb
+    {
+        queueInLoop(cb);
     }
 }
 
@@ -159,20 +229,14 @@ void EventLoop::handleRead()
     ssize_t n = read(wakeupFd_, &one, sizeof(one));
     if (n != sizeof(one))
     {
-        LOG_ERROR("EventLoop::handleRead() reads %lu bytes instead of 8\n", n);
+        LOG_ERROR_RATELIMITED(5, 1, "EventLoop::handleRead() reads %ld bytes instead of 8\n", n);
     }
 }
 
 // 用来唤醒loop所在线程 向wakeupFd_写一个数据 wakeupChannel 就发生读事件 当前 loop 线程就会被唤醒
 void EventLoop::wakeup()
 {
-    uint64_t one = 1;
-    ssize_t n = write(wakeupFd_, &one, sizeof one);
-    if(n != sizeof one)
-    {
-        LOG_ERROR("EventLoop::wakeup() writes %lu bytes instead of 8\n", n);
-    }
-
+    endpoint_->wakeup();
 }
 
 // EventLoop的方法 => Poller的方法
@@ -186,6 +250,11 @@ void EventLoop::removeChannel(Channel *channel)
     poller_->removeChannel(channel);
 }
 
+int64_t EventLoop::busyMicroSeconds() const
+{
+    return CycleClock::toMicroSeconds(busyCycles_.load(std::memory_order_relaxed));
+}
+
 bool EventLoop::hasChannel(Channel *channel)
 {
     return poller_->hasChannel(channel);
@@ -207,4 +276,162 @@ void EventLoop::doPendingFunctors()
         functor();
     }
     callingPendingFunctors_ = false; 
-}
\ No newline at end of file
+}
+
+void EventLoop::doIterationEndFunctors()
+{
+    // 执行中可能再登记新的 留到下一轮
+    std::vector<Functor> functors;
+    functors.swap(iterationEndFunctors_);
+    for (const Functor &functor : functors)
+    {
+        functor();
+    }
+}
+
+EventLoop *EventLoop::loopOfCurrentThread()
+{
+    return t_loopInThisThread;
+}
+
+void EventLoop::sendTo(EventLoop *targetLoop, Functor cb)
+{
+    assert(isInLoopThread());
+    if(targetLoop == this)
+    {
+        queueInLoop(std::move(cb));
+        return;
+    }
+
+    ShardEndpoint *target = targetLoop->endpoint_.get();
+    Outbox &outbox = outboxes_[targetLoop];
+    if(!outbox.queue || !sameOwner(outbox.target, targetLoop->endpoint_))
+    {
+        // 第一次向 targetLoop 发送 或者原来这个地址上的 loop 已经析构 建立队列交给对方 之后都走无锁队列
+        outbox.queue = std::make_shared<FunctorQueue>(kShardQueueSize);
+        outbox.overflow.clear();
+        outbox.target = targetLoop->endpoint_;
+        {
+            std::unique_lock<std::mutex> lock(target->mutex);
+            target->newInboxes.push_back(Inbox{outbox.queue, endpoint_});
+            target->hasNewInboxes.store(true, std::memory_order_release);
+        }
+        target->wakeup();
+    }
+
+    if(!outbox.overflow.empty() || !outbox.queue->push(std::move(cb)))
+    {
+        outbox.overflow.push_back(std::move(cb));   // 下一轮 doShardFunctors 中重试
+        return;
+    }
+
+    // 与 pollTimeoutMs 中的 fence 配对：要么对方看到了新消息不阻塞 要么这里看到对方在睡眠并唤醒它
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(target->sleeping.load(std::memory_order_relaxed))
+    {
+        target->wakeup();
+    }
+}
+
+void EventLoop::doShardFunctors()
+{
+    if(endpoint_->hasNewInboxes.load(std::memory_order_acquire))
+    {
+        std::unique_lock<std::mutex> lock(endpoint_->mutex);
+        for(Inbox &inbox : endpoint_->newInboxes)
+        {
+            inboxes_.push_back(std::move(inbox));
+        }
+        endpoint_->newInboxes.clear();
+        endpoint_->hasNewInboxes.store(false, std::memory_order_relaxed);
+    }
+
+    Functor functor;
+    for(size_t i = 0; i < inboxes_.size();)
+    {
+        // 先看发送方是否已经析构 acquire 保证它析构前发出的消息在下面都能取到
+        bool producerGone = inboxes_[i].producer.expired();
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // 每个队列每轮最多处理一个容量的消息 避免一个繁忙的对端饿死本 loop 上的 IO
+        std::shared_ptr<FunctorQueue> queue = inboxes_[i].queue;
+        for(size_t n = queue->capacity(); n > 0 && queue->pop(functor); --n)
+        {
+            functor();
+        }
+        if(producerGone && queue->empty())
+        {
+            inboxes_.erase(inboxes_.begin() + i);
+            continue;
+        }
+        ++i;
+    }
+
+    for(auto it = outboxes_.begin(); it != outboxes_.end();)
+    {
+        Outbox &outbox = it->second;
+        if(outbox.overflow.empty() && !outbox.target.expired())
+        {
+            ++it;
+            continue;
+        }
+        std::shared_ptr<ShardEndpoint> target = outbox.target.lock();
+        if(!target)
+        {
+            if(!outbox.overflow.empty())
+            {
+                LOG_ERROR_RATELIMITED(5, 1, "EventLoop::doShardFunctors() loop %p destroyed, %zu messages dropped\n",
+                                      it->first, outbox.overflow.size());
+            }
+            it = outboxes_.erase(it);
+            continue;
+        }
+
+        bool flushed = false;
+        while(!outbox.overflow.empty() && outbox.queue->push(std::move(outbox.overflow.front())))
+        {
+            outbox.overflow.pop_front();
+            flushed = true;
+        }
+        if(flushed)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(target->sleeping.load(std::memory_order_relaxed))
+            {
+                target->wakeup();
+            }
+        }
+        ++it;
+    }
+}
+
+int EventLoop::pollTimeoutMs()
+{
+    if(!iterationEndFunctors_.empty())
+    {
+        return 0;                              // 上一轮末尾又登记了回调 不能阻塞
+    }
+    if(inboxes_.empty() && outboxes_.empty())
+    {
+        return kPollTimeMs;
+    }
+
+    endpoint_->sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(const Inbox &inbox : inboxes_)
+    {
+        if(!inbox.queue->empty())
+        {
+            endpoint_->sleeping.store(false, std::memory_order_relaxed);
+            return 0;
+        }
+    }
+    for(const auto &item : outboxes_)
+    {
+        if(!item.second.overflow.empty())
+        {
+            return 1;            // 对方队列满了 稍后重试
+        }
+    }
+    return kPollTimeMs;
+}
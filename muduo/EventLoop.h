@@ -5,10 +5,14 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <assert.h>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "SpscQueue.h"
 
 class Channel;
 class Poller;
@@ -32,7 +36,10 @@ public:
     // 退出事件循环
     void quit();
 
-    Timestamp pollReturnTime() const { pollRetureTime_;}
+    Timestamp pollReturnTime() const { return pollRetureTime_; }
+
+    // loop 处理事件和回调累计花费的时间(不含阻塞在 poll 上的时间) 可在其他线程读取 用于负载均衡
+    int64_t busyMicroSeconds() const;
 
     
     void runInLoop(Functor cb);                // 在当前loop中执行
@@ -40,6 +47,24 @@ public:
 
     void wakeup();                             // 通过eventfd唤醒loop所在的线程
 
+    /**
+     * 在本 loop 线程中调用 把 cb 交给 targetLoop 执行
+     * 每一对 (本loop, targetLoop) 第一次使用时建立一个专用的 SPSC 队列 之后的消息不经过 pendingFunctors_ 的互斥锁
+     * 目标 loop 每轮循环都会检查自己的队列 只有在它阻塞于 poll 时才需要 wakeup
+     * 调用时 targetLoop 必须还活着 之后它析构了 两边的 loop 会各自清掉这一对队列 还没执行的消息丢弃
+     **/
+    void sendTo(EventLoop *targetLoop, Functor cb);
+
+    // 在本 loop 线程中调用 cb 在本轮循环的最后(doPendingFunctors 之后 下一次 poll 之前)执行 用来合并一轮中的多次写
+    void runAfterIteration(Functor cb)
+    {
+        assert(isInLoopThread());
+        iterationEndFunctors_.push_back(std::move(cb));
+    }
+
+    // 当前线程所属的 EventLoop 没有则返回 nullptr
+    static EventLoop *loopOfCurrentThread();
+
     // EventLoop的方法 => Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
@@ -51,6 +76,9 @@ public:
 private:
     void handleRead();
     void doPendingFunctors();
+    void doShardFunctors();                    // 执行其他 loop 通过 sendTo 发来的回调 并把积压的消息写入对方队列
+    int pollTimeoutMs();                       // 有跨 loop 消息待处理时不阻塞
+    void doIterationEndFunctors();
 
     using ChannelList  = std::vector<Channel*>;
 
@@ -61,9 +89,17 @@ private:
     const pid_t threadId_;                     // 记录当前 EventLoop 是被哪个线程 id 创建的 即标识了当前 EventLoop 的所属线程id , 判断 EventLoop 在不在它自己的线程里面
 
     Timestamp pollRetureTime_;                 // Poller返回发生事件的 Channels 的时间点
+    std::atomic<uint64_t> busyCycles_;         // CycleClock 计数 只有 loop 线程写
 
     std::unique_ptr<Poller> poller_;           // 会自动析构
 
+    /**
+     * 其他 loop 给本 loop 发消息要用到的状态 和 EventLoop 分开用 shared_ptr 管理 wakeupFd_ 由它创建和关闭
+     * 对端只持有 weak_ptr 本 loop 析构后对端发现 lock 失败就清掉这一对队列 不会再访问已经释放的 EventLoop
+     **/
+    struct ShardEndpoint;
+    std::shared_ptr<ShardEndpoint> endpoint_;  // 必须在 wakeupFd_ 之前初始化
+
     int wakeupFd_;                             // 使用 eventfd() 创建， 作用：当 mainLoop 获取一个新用户的 Channel 需通过轮询算法选择一个 subLoop 通过该成员唤醒 subLoop 处理 Channel
     std::unique_ptr<Channel> wakeupChannel_;   // wakeupFd_ 存储在这个 channel 里面
 
@@ -73,6 +109,24 @@ private:
     std::atomic_bool callingPendingFunctors_; // 标识当前 loop 是否有需要执行的回调操作
     std::vector<Functor> pendingFunctors_;    // 存储 loop 需要执行的所有回调操作
     std::mutex mutex_;                        // 互斥锁 用来保护上面 vector 容器的线程安全操作
+    std::vector<Functor> iterationEndFunctors_;   // runAfterIteration 只在本线程访问
+
+    using FunctorQueue = SpscQueue<Functor>;
+    struct Inbox
+    {
+        std::shared_ptr<FunctorQueue> queue;
+        std::weak_ptr<ShardEndpoint> producer;   // 发送方 loop 析构后 取完剩下的消息就删掉
+    };
+    struct Outbox
+    {
+        std::shared_ptr<FunctorQueue> queue;  // 本 loop 生产 目标 loop 消费
+        std::deque<Functor> overflow;         // 队列满时暂存 保持消息顺序
+        std::weak_ptr<ShardEndpoint> target;  // 目标 loop 析构后删掉 同一地址上新建的 loop 重新建队列
+    };
+    std::vector<Inbox> inboxes_;                           // 其他 loop 发给本 loop 的队列 只在本线程访问
+    std::unordered_map<EventLoop*, Outbox> outboxes_;      // 本 loop 发往其他 loop 的队列 只在本线程访问
+
+    std::atomic<uint64_t> quiescentState_;                 // RCU 静止状态计数 奇数表示离线(阻塞在 poll 上) 只有本线程写
 };
 
 /*
@@ -17,9 +17,16 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
 EventLoopThread::~EventLoopThread()
 {
     exiting_ = true;
-    if(loop_ != nullptr)
     {
-        loop_->quit();
+        // 持锁调用quit 子线程在loop()返回后也要持锁才能把loop_置空 保证quit时栈上的loop对象还没有析构
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(loop_ != nullptr)
+        {
+            loop_->quit();
+        }
+    }
+    if(thread_.started())
+    {
         thread_.join();
     }
 }
@@ -31,7 +38,7 @@ EventLoop *EventLoopThread::startLoop()
     EventLoop* loop = nullptr;
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        while(loop == nullptr)  //创建的子线程还未通知
+        while(loop_ == nullptr) //创建的子线程还未通知
         {
             cond_.wait(lock);  // 一直等待
         }
@@ -2,6 +2,8 @@
 
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "Logger.h"
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
 : baseLoop_(baseLoop)
@@ -9,6 +11,7 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
 , started_(false)
 , numThreads_(0)
 , next_(0)
+, nextThreadId_(0)
 {
 }
 
@@ -21,15 +24,12 @@ EventLoopThreadPool::~EventLoopThreadPool()
 void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
+    threadInitCallback_ = cb;
 
     // 没有通过 setThreadNum 设置了线程数量,就不会进来
     for(int i = 0; i < numThreads_ ; i++)
     {   
-        char buf[name_.size() + 32];
-        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
-        EventLoopThread* t = new EventLoopThread(cb, buf);
-        threads_.push_back(std::unique_ptr<EventLoopThread>(t));
-        loops_.push_back(t->startLoop());   // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
+        addThread();
     }
 
     // 整个服务端只有一个线程，运行着baseloop
@@ -39,6 +39,159 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 }
 
+void EventLoopThreadPool::addThread()
+{
+    char buf[name_.size() + 32];
+    snprintf(buf, sizeof buf, "%s%d", name_.c_str(), nextThreadId_++);
+    EventLoopThread* t = new EventLoopThread(threadInitCallback_, buf);
+    threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+    loops_.push_back(t->startLoop());   // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
+}
+
+void EventLoopThreadPool::resize(int numThreads, const DrainCallback &drainCb)
+{
+    if(!started_)
+    {
+        numThreads_ = numThreads;
+        return;
+    }
+    if(numThreads < 0)
+    {
+        numThreads = 0;
+    }
+    LOG_INFO("EventLoopThreadPool %s resize %d => %d\n", name_.c_str(), numThreads_, numThreads);
+
+    while(static_cast<int>(loops_.size()) < numThreads)
+    {
+        addThread();
+    }
+
+    while(static_cast<int>(loops_.size()) > numThreads)
+    {
+        // 先从 loops_ 中摘除 getNextLoop 不会再把新连接分给它
+        EventLoop* loop = loops_.back();
+        loops_.pop_back();
+        drainingThreads_.emplace_back(loop, std::move(threads_.back()));
+        threads_.pop_back();
+        loop->runInLoop(std::bind(&EventLoopThreadPool::drainLoop, this, loop, drainCb));
+    }
+
+    numThreads_ = numThreads;
+    if(next_ >= static_cast<int>(loops_.size()))
+    {
+        next_ = 0;
+    }
+}
+
+// 在被摘除的 subLoop 线程中执行
+void EventLoopThreadPool::drainLoop(EventLoop *loop, const DrainCallback &drainCb)
+{
+    if(drainCb)
+    {
+        drainCb(loop);
+    }
+    // 先回到 baseLoop_ 之前 baseLoop_ 里排着的发往这个 loop 的回调(比如销毁已经关闭的连接)都会先交给它
+    baseLoop_->queueInLoop(std::bind(&EventLoopThreadPool::stopLoop, this, loop));
+}
+
+// 在 baseLoop_ 中执行 退出操作排在这个 loop 所有已有回调的后面 drainCb 中 queueInLoop 的迁移操作也不会丢失
+void EventLoopThreadPool::stopLoop(EventLoop *loop)
+{
+    loop->queueInLoop([this, loop]() {
+        loop->quit();
+        baseLoop_->queueInLoop(std::bind(&EventLoopThreadPool::removeThread, this, loop));
+    });
+}
+
+void EventLoopThreadPool::removeThread(EventLoop *loop)
+{
+    for(auto it = drainingThreads_.begin(); it != drainingThreads_.end(); ++it)
+    {
+        if(it->first == loop)
+        {
+            lastBusyMicroSeconds_.erase(loop);
+            drainingThreads_.erase(it);   // ~EventLoopThread() join 已经退出循环的线程
+            break;
+        }
+    }
+}
+
+bool EventLoopThreadPool::rebalance(const MigrateCallback &migrateCb, double imbalanceRatio)
+{
+    if(loops_.size() < 2)
+    {
+        return false;
+    }
+
+    EventLoop *busiest = nullptr;
+    EventLoop *idlest = nullptr;
+    int64_t maxBusy = -1;
+    int64_t minBusy = -1;
+    for(EventLoop *loop : loops_)
+    {
+        int64_t busy = loop->busyMicroSeconds();
+        int64_t delta = busy - lastBusyMicroSeconds_[loop];     // 新扩容的 loop 从 0 开始
+        lastBusyMicroSeconds_[loop] = busy;
+        if(delta > maxBusy)
+        {
+            maxBusy = delta;
+            busiest = loop;
+        }
+        if(minBusy < 0 || delta < minBusy)
+        {
+            minBusy = delta;
+            idlest = loop;
+        }
+    }
+
+    if(busiest == idlest || maxBusy <= 0 || maxBusy < imbalanceRatio * minBusy)
+    {
+        return false;
+    }
+    LOG_INFO("EventLoopThreadPool %s rebalance: loop %p busy %ldus, loop %p busy %ldus\n",
+             name_.c_str(), busiest, maxBusy, idlest, minBusy);
+    busiest->queueInLoop(std::bind(migrateCb, busiest, idlest));
+    return true;
+}
+
+namespace
+{
+    // 只在调用方 loop 线程中访问
+    struct Barrier
+    {
+        size_t remaining;
+        EventLoopThreadPool::CompleteCallback onComplete;
+    };
+}
+
+void EventLoopThreadPool::runOnAllLoops(const LoopCallback &fn, const CompleteCallback &onComplete)
+{
+    EventLoop *callerLoop = EventLoop::loopOfCurrentThread();
+    if(callerLoop == nullptr)
+    {
+        LOG_FATAL("runOnAllLoops must be called in an EventLoop thread\n");
+    }
+
+    std::vector<EventLoop *> loops = getAllLoops();
+    Barrier *barrier = new Barrier{loops.size(), onComplete};
+    for(EventLoop *loop : loops)
+    {
+        callerLoop->sendTo(loop, [fn, loop, callerLoop, barrier]() {
+            fn(loop);
+            loop->sendTo(callerLoop, [barrier]() {
+                if(--barrier->remaining == 0)
+                {
+                    if(barrier->onComplete)
+                    {
+                        barrier->onComplete();
+                    }
+                    delete barrier;
+                }
+            });
+        });
+    }
+}
+
 // 如果工作在多线程中，baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
 EventLoop *EventLoopThreadPool::getNextLoop()
 {
@@ -67,4 +220,4 @@ std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
     {
         return loops_;
     }
-}
\ No newline at end of file
+}
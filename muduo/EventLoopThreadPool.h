@@ -1,10 +1,11 @@
-#pragma one
+#pragma once
 #include "noncopyable.h"
 
 #include <functional>
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 class EventLoop;
 class EventLoopThread;
@@ -14,32 +15,69 @@ class EventLoopThreadPool : noncopyable
 public:
     // 也是 EventLoopThread.h 中定义的，因为Pool管理它
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // 缩容时在被摘除的 subLoop 线程中调用 可以在这里把该 loop 上的连接迁移走或关闭 返回后该 loop 退出
+    using DrainCallback = std::function<void(EventLoop*)>;
+    // 负载均衡时在过载的 from 线程中调用 由上层挑选 from 上的热点连接 通过 TcpConnection::migrateTo 迁移到 to
+    // TcpServer::rebalance 按连接最近收到的字节数挑选
+    using MigrateCallback = std::function<void(EventLoop* from, EventLoop* to)>;
+    using LoopCallback = std::function<void(EventLoop*)>;
+    using CompleteCallback = std::function<void()>;
 
     EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg);
 
     // 析构不做任何事情
     ~EventLoopThreadPool();
 
-    // 设置底层线程数量
+    // 设置底层线程数量 start() 之前调用
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
     // 初始化回调
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
+    /**
+     * start() 之后在 baseLoop_ 线程中调整 subLoop 数量
+     * 扩容：按 start() 时的 ThreadInitCallback 新建线程
+     * 缩容：从尾部摘除 subLoop 立即停止向其分配新连接 然后在该 loop 线程中执行 drainCb
+     *       再经过 baseLoop_ 通知它退出 退出前会执行完已经发给它的回调 线程由 baseLoop_ 异步回收
+     **/
+    void resize(int numThreads, const DrainCallback& drainCb = DrainCallback());
+
+    /**
+     * 在 baseLoop_ 线程中周期性调用 比较各 subLoop 自上次调用以来的忙碌时间
+     * 最忙的 loop 超过最闲的 loop 的 imbalanceRatio 倍时 在最忙的 loop 线程中调用 migrateCb(最忙, 最闲)
+     * 返回是否触发了迁移
+     **/
+    bool rebalance(const MigrateCallback& migrateCb, double imbalanceRatio = 2.0);
+
+    /**
+     * 在某个 loop 线程中调用 让 getAllLoops() 中的每个 loop 在自己的线程里执行 fn(loop)
+     * 每个 loop 只收到一条消息(最多一次 wakeup) 全部执行完后在调用方 loop 中执行 onComplete 期间不阻塞任何 loop
+     **/
+    void runOnAllLoops(const LoopCallback& fn, const CompleteCallback& onComplete = CompleteCallback());
+
     // 如果工作在多线程中，baseLoop_(mainLoop) 会默认以轮询的方式分配 Channel 给 subLoop
     EventLoop* getNextLoop();
 
     std::vector<EventLoop*> getAllLoops();
 
     bool started() const { return started_;}
+    int numThreads() const { return numThreads_; }
     const std::string name() const { return name_; }
 private:
+    void addThread();
+    void drainLoop(EventLoop* loop, const DrainCallback& drainCb);
+    void stopLoop(EventLoop* loop);
+    void removeThread(EventLoop* loop);   // 在 baseLoop_ 中回收已经退出的 subLoop 线程
+
     EventLoop* baseLoop_;  // EventLoop loop;用户使用的线程，作为新用户的连接，和已连接用户的读写事件
     std::string name_;
     bool started_;
     int numThreads_;
     int next_;
+    int nextThreadId_;     // 线程名字的序号 缩容后再扩容也不会重名
+    ThreadInitCallback threadInitCallback_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_; 
+    std::vector<std::pair<EventLoop*, std::unique_ptr<EventLoopThread>>> drainingThreads_;   // 正在退出的 subLoop
+    std::unordered_map<EventLoop*, int64_t> lastBusyMicroSeconds_;                          // 上次 rebalance 时各 loop 的忙碌时间
 };
-
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string.h>
+
+#include "noncopyable.h"
+
+const int kSmallBuffer = 4000;          // 单条日志
+const int kLargeBuffer = 4000 * 1000;   // 异步日志前后端交换的大缓冲
+
+// 定长缓冲区 只追加 放不下时丢弃
+template <int SIZE>
+class FixedBuffer : noncopyable
+{
+public:
+    FixedBuffer() : cur_(data_) {}
+
+    void append(const char *buf, size_t len)
+    {
+        if (static_cast<size_t>(avail()) > len)
+        {
+            ::memcpy(cur_, buf, len);
+            cur_ += len;
+        }
+    }
+
+    const char *data() const { return data_; }
+    int length() const { return static_cast<int>(cur_ - data_); }
+    int avail() const { return static_cast<int>(end() - cur_); }
+
+    char *current() { return cur_; }
+    void add(size_t len) { cur_ += len; }
+
+    void reset() { cur_ = data_; }
+    void bzero() { ::memset(data_, 0, sizeof data_); }
+
+private:
+    const char *end() const { return data_ + sizeof data_; }
+
+    char data_[SIZE];
+    char *cur_;
+};
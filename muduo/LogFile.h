@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+
+#include "noncopyable.h"
+
+/**
+ * 滚动日志文件 只在异步日志的后端线程中使用 不加锁
+ * 文件写满 rollSize 字节或者跨天时新建一个文件
+ * 文件名：basename.20220601-120000.hostname.pid.log
+ **/
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename, off_t rollSize, int flushInterval = 3, int checkEveryN = 1024);
+    ~LogFile();
+
+    void append(const char *logline, int len);
+    void flush();
+    bool rollFile();
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;      // 秒
+    const int checkEveryN_;        // 每写 checkEveryN_ 次检查一次是否需要跨天滚动或 flush
+
+    int count_;
+    time_t startOfPeriod_;         // 当前文件所在的那一天
+    time_t lastRoll_;
+    time_t lastFlush_;
+
+    FILE *fp_;
+    off_t writtenBytes_;
+    char buffer_[64 * 1024];       // FILE 的用户态缓冲
+
+    const static int kRollPerSeconds_ = 60 * 60 * 24;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+#include "noncopyable.h"
+
+/**
+ * 变长记录的单生产者单消费者字节环形缓冲 用作每个线程的日志暂存区
+ * 每条记录前有 8 字节头(记录长度) 整体按 8 字节对齐 记录在缓冲区中总是连续的
+ * 尾部放不下时写一个回绕标记 从头开始写 消费者遇到标记直接跳到开头
+ **/
+class LogRingBuffer : noncopyable
+{
+public:
+    // capacity 向上取整为 2 的幂
+    explicit LogRingBuffer(size_t capacity)
+        : head_(0)
+        , cachedTail_(0)
+        , frontSize_(0)
+        , tail_(0)
+        , cachedHead_(0)
+        , reservedTail_(0)
+    {
+        size_t size = 64;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // 单条记录最多占一半容量 超过的记录永远放不进来 等待也没用
+    bool fits(size_t len) const { return recordSize(len) <= (mask_ + 1) / 2; }
+
+    // 生产者：预留 len 字节的连续空间 空间不足返回 nullptr 写完后调用 commit
+    char *reserve(size_t len)
+    {
+        const size_t need = recordSize(len);
+        const size_t capacity = mask_ + 1;
+        if (need > capacity / 2)
+        {
+            return nullptr;
+        }
+
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        size_t pos = tail & mask_;
+        size_t toEnd = capacity - pos;
+        size_t total = need <= toEnd ? need : toEnd + need;
+        if (total > capacity - (tail - cachedHead_))
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (total > capacity - (tail - cachedHead_))
+            {
+                return nullptr;
+            }
+        }
+
+        if (need > toEnd)
+        {
+            writeLength(pos, kWrapMarker);
+            tail += toEnd;
+            pos = 0;
+        }
+        writeLength(pos, static_cast<uint32_t>(len));
+        reservedTail_ = tail + need;
+        return &buffer_[pos + kHeaderSize];
+    }
+
+    void commit() { tail_.store(reservedTail_, std::memory_order_release); }
+
+    // 消费者：取下一条记录 没有则返回 nullptr 处理完后调用 pop
+    const char *front(size_t *len)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (head == cachedTail_)
+            {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+                if (head == cachedTail_)
+                {
+                    return nullptr;
+                }
+            }
+            size_t pos = head & mask_;
+            uint32_t length = readLength(pos);
+            if (length == kWrapMarker)
+            {
+                head += mask_ + 1 - pos;
+                head_.store(head, std::memory_order_release);
+                continue;
+            }
+            *len = length;
+            frontSize_ = recordSize(length);
+            return &buffer_[pos + kHeaderSize];
+        }
+    }
+
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + frontSize_, std::memory_order_release); }
+
+    bool empty() const { return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire); }
+
+private:
+    static const size_t kHeaderSize = 8;
+    static const uint32_t kWrapMarker = 0xFFFFFFFF;
+    static const size_t kCacheLineSize = 64;
+
+    static size_t recordSize(size_t len) { return (len + kHeaderSize + 7) & ~static_cast<size_t>(7); }
+
+    void writeLength(size_t pos, uint32_t len) { ::memcpy(&buffer_[pos], &len, sizeof len); }
+    uint32_t readLength(size_t pos) const
+    {
+        uint32_t len;
+        ::memcpy(&len, &buffer_[pos], sizeof len);
+        return len;
+    }
+
+    std::vector<char> buffer_;
+    size_t mask_;
+
+    char pad0_[kCacheLineSize];
+    std::atomic<uint64_t> head_;       // 消费者写
+    uint64_t cachedTail_;
+    size_t frontSize_;
+
+    char pad1_[kCacheLineSize];
+    std::atomic<uint64_t> tail_;       // 生产者写
+    uint64_t cachedHead_;
+    uint64_t reservedTail_;
+    char pad2_[kCacheLineSize];
+};
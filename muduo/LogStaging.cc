@@ -0,0 +1,195 @@
+#include <sched.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+
+#include "LogStaging.h"
+#include "Logger.h"
+#include "CurrentThread.h"
+
+__thread LogStagingBuffer *t_logStagingBuffer = nullptr;
+
+std::atomic_bool LogStaging::consumerSleeping_(false);
+
+namespace
+{
+    std::mutex g_buffersMutex;
+    std::vector<LogStagingBuffer *> g_buffers;
+    std::atomic_bool g_consumerAttached(false);
+
+    // 后端空闲时在这里睡眠
+    std::mutex g_wakeupMutex;
+    std::condition_variable g_wakeupCond;
+    bool g_wakeupPending = false;
+
+    // 默认 DEBUG/INFO 丢弃 ERROR/FATAL 等待 错误日志不能丢
+    std::atomic<int> g_fullPolicies[] = {
+        {kLogDropWhenFull},
+        {kLogDropWhenFull},
+        {kLogBlockWhenFull},
+        {kLogBlockWhenFull},
+    };
+
+    // 线程退出时把暂存区标记为 retired 由后端取完剩余记录后释放
+    struct StagingBufferRetirer
+    {
+        ~StagingBufferRetirer()
+        {
+            if (t_logStagingBuffer)
+            {
+                t_logStagingBuffer->retired.store(true, std::memory_order_release);
+                t_logStagingBuffer = nullptr;
+            }
+        }
+    };
+    thread_local StagingBufferRetirer t_stagingBufferRetirer;
+
+    bool validLevel(int level) { return level >= DEBUG && level <= FATAL; }
+}
+
+LogStagingBuffer *LogStaging::createBuffer()
+{
+    LogStagingBuffer *staging = new LogStagingBuffer(kBufferSize);
+    staging->tid = CurrentThread::tid();
+    {
+        std::unique_lock<std::mutex> lock(g_buffersMutex);
+        g_buffers.push_back(staging);
+    }
+    t_logStagingBuffer = staging;
+    (void)&t_stagingBufferRetirer;           // 使用一次 线程退出时才会析构
+    return staging;
+}
+
+char *LogStaging::reserveSlow(LogStagingBuffer *staging, int level, size_t len)
+{
+    // 超大的记录永远放不进来 和没有后端在消费时一样 等待没有意义 直接丢弃
+    if (fullPolicy(level) == kLogBlockWhenFull && staging->ring.fits(len))
+    {
+        while (g_consumerAttached.load(std::memory_order_acquire))
+        {
+            ::sched_yield();
+            char *p = staging->ring.reserve(len);
+            if (p != nullptr)
+            {
+                return p;
+            }
+        }
+    }
+    staging->dropped.store(staging->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void LogStaging::appendText(int level, const char *line, int len)
+{
+    char *p = reserve(level, kRecordHeaderSize + len);
+    if (p == nullptr)
+    {
+        return;
+    }
+    uint32_t header[2] = {kTextRecord, 0};
+    ::memcpy(p, header, sizeof header);
+    ::memcpy(p + kRecordHeaderSize, line, len);
+    commit();
+}
+
+void LogStaging::setFullPolicy(int level, LogFullPolicy policy)
+{
+    if (validLevel(level))
+    {
+        g_fullPolicies[level].store(policy, std::memory_order_relaxed);
+    }
+}
+
+LogFullPolicy LogStaging::fullPolicy(int level)
+{
+    if (!validLevel(level))
+    {
+        return kLogDropWhenFull;
+    }
+    return static_cast<LogFullPolicy>(g_fullPolicies[level].load(std::memory_order_relaxed));
+}
+
+bool LogStaging::attachConsumer()
+{
+    bool expected = false;
+    return g_consumerAttached.compare_exchange_strong(expected, true);
+}
+
+void LogStaging::detachConsumer()
+{
+    g_consumerAttached.store(false, std::memory_order_release);
+}
+
+size_t LogStaging::drain(const RecordCallback &onRecord, const DroppedCallback &onDropped)
+{
+    std::vector<LogStagingBuffer *> buffers;
+    {
+        std::unique_lock<std::mutex> lock(g_buffersMutex);
+        buffers = g_buffers;
+    }
+
+    size_t records = 0;
+    for (LogStagingBuffer *staging : buffers)
+    {
+        bool retired = staging->retired.load(std::memory_order_acquire);   // 先读标志再取数据 保证释放前取完
+
+        size_t len = 0;
+        const char *record = nullptr;
+        while ((record = staging->ring.front(&len)) != nullptr)
+        {
+            onRecord(record, len);
+            staging->ring.pop();
+            ++records;
+        }
+
+        uint64_t dropped = staging->dropped.load(std::memory_order_relaxed);
+        if (dropped != staging->reportedDropped)
+        {
+            onDropped(staging->tid, dropped - staging->reportedDropped);
+            staging->reportedDropped = dropped;
+        }
+
+        if (retired)
+        {
+            std::unique_lock<std::mutex> lock(g_buffersMutex);
+            g_buffers.erase(std::find(g_buffers.begin(), g_buffers.end(), staging));
+            delete staging;
+        }
+    }
+    return records;
+}
+
+bool LogStaging::allEmpty()
+{
+    std::unique_lock<std::mutex> lock(g_buffersMutex);
+    for (LogStagingBuffer *staging : g_buffers)
+    {
+        if (!staging->ring.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LogStaging::waitForRecords(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(g_wakeupMutex);
+    // 先置睡眠标志再检查暂存区 和 commit 配对
+    consumerSleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!g_wakeupPending && allEmpty())
+    {
+        g_wakeupCond.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+    }
+    consumerSleeping_.store(false, std::memory_order_relaxed);
+    g_wakeupPending = false;
+}
+
+void LogStaging::wakeConsumer()
+{
+    std::unique_lock<std::mutex> lock(g_wakeupMutex);
+    g_wakeupPending = true;
+    g_wakeupCond.notify_one();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "LogRingBuffer.h"
+
+// 暂存区满时的处理方式 按日志级别分别设置
+enum LogFullPolicy
+{
+    kLogDropWhenFull,     // 丢弃并计数 由后端输出一条丢弃统计
+    kLogBlockWhenFull,    // 等待后端腾出空间
+};
+
+// 每个线程(CurrentThread::tid())一个暂存区 只有所属线程写 只有后端线程读
+struct LogStagingBuffer
+{
+    explicit LogStagingBuffer(size_t capacity) : ring(capacity), tid(0), dropped(0), retired(false), reportedDropped(0) {}
+
+    LogRingBuffer ring;
+    int tid;
+    std::atomic<uint64_t> dropped;     // 暂存区满时丢弃的条数 只有所属线程写
+    std::atomic_bool retired;          // 线程已经退出 后端取完后释放
+    uint64_t reportedDropped;          // 后端已经报告过的丢弃条数 只有后端线程访问
+};
+
+extern __thread LogStagingBuffer *t_logStagingBuffer;
+
+/**
+ * 日志前端的每线程暂存区
+ * 各线程把日志记录写进自己的 SPSC 环形缓冲 线程之间不竞争 同一线程的日志保持顺序
+ * 记录的前 4 字节是类型：kTextRecord 表示格式化好的一行文本 其他值是 BinaryLogging 的 siteId
+ * 同一时间只能有一个后端(AsyncLogging 或 BinaryLogging)消费
+ **/
+class LogStaging : noncopyable
+{
+public:
+    static const uint32_t kTextRecord = 0xFFFFFFFE;
+    static const size_t kRecordHeaderSize = 8;       // 类型 + 填充 保持 8 字节对齐
+
+    using RecordCallback = std::function<void(const char *record, size_t len)>;
+    using DroppedCallback = std::function<void(int tid, uint64_t dropped)>;
+
+    // 前端：在本线程的暂存区预留 len 字节 满了按 level 的策略丢弃(返回 nullptr)或等待 超过暂存区一半的记录总是丢弃 写完调用 commit
+    static char *reserve(int level, size_t len)
+    {
+        LogStagingBuffer *staging = t_logStagingBuffer;
+        if (__builtin_expect(staging == nullptr, 0))
+        {
+            staging = createBuffer();
+        }
+        char *p = staging->ring.reserve(len);
+        if (__builtin_expect(p == nullptr, 0))
+        {
+            p = reserveSlow(staging, level, len);
+        }
+        return p;
+    }
+
+    static void commit()
+    {
+        t_logStagingBuffer->ring.commit();
+        // 先发布记录再看后端是否在睡眠 和 waitForRecords 的顺序相反 两边都有全屏障 不会漏掉唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (__builtin_expect(consumerSleeping_.load(std::memory_order_relaxed), 0))
+        {
+            wakeConsumer();
+        }
+    }
+
+    // 前端：一整行文本
+    static void appendText(int level, const char *line, int len);
+
+    static void setFullPolicy(int level, LogFullPolicy policy);
+    static LogFullPolicy fullPolicy(int level);
+
+    // 后端：登记为唯一的消费者 已有消费者时返回 false
+    static bool attachConsumer();
+    static void detachConsumer();
+
+    // 后端：取出所有线程暂存区中的记录 释放已退出线程的暂存区 返回取出的记录数
+    static size_t drain(const RecordCallback &onRecord, const DroppedCallback &onDropped);
+    // 后端：所有暂存区都空时睡眠 直到前端提交记录 有人调用 wakeConsumer 或者超时
+    static void waitForRecords(int timeoutMs);
+    // 唤醒 waitForRecords 还没进入等待时下一次等待直接返回 停止后端时用
+    static void wakeConsumer();
+
+private:
+    static const size_t kBufferSize = 1024 * 1024;
+
+    static LogStagingBuffer *createBuffer();
+    static char *reserveSlow(LogStagingBuffer *staging, int level, size_t len);
+    static bool allEmpty();
+
+    static std::atomic_bool consumerSleeping_;
+};
@@ -1,7 +1,89 @@
-#include <iostream>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 
 #include "Logger.h"
 #include "Timestamp.h"
+#include "FixedBuffer.h"
+#include "CycleClock.h"
+#include "CurrentThread.h"
+
+std::atomic<int> Logger::logLevel_(INFO);
+
+static const char *const kLevelNames[] = {
+    "[DEBUG]",
+    "[INFO]",
+    "[ERROR]",
+    "[FATAL]",
+};
+
+static void defaultOutput(const char *msg, int len, int)
+{
+    ::fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    ::fflush(stdout);
+}
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
+
+const char *Logger::levelName(int level)
+{
+    return (level >= DEBUG && level <= FATAL) ? kLevelNames[level] : "";
+}
+
+bool Logger::sample(uint32_t oneIn)
+{
+    static __thread uint32_t t_state = 0;
+    if (oneIn <= 1)
+    {
+        return true;
+    }
+    uint32_t x = t_state;
+    if (x == 0)
+    {
+        x = static_cast<uint32_t>(CurrentThread::tid()) * 2654435761u | 1;   // 各线程的种子不同
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t_state = x;
+    return x % oneIn == 0;
+}
+
+bool LogRateLimiter::allow(uint64_t *suppressed)
+{
+    uint64_t now = CycleClock::now();
+    uint64_t start = windowStart_.load(std::memory_order_relaxed);
+    uint64_t interval = intervalCycles_.load(std::memory_order_relaxed);
+    if (interval == 0)
+    {
+        // 多个线程同时换算结果相同 重复写入没有关系
+        interval = CycleClock::fromSeconds(seconds_);
+        intervalCycles_.store(interval, std::memory_order_relaxed);
+    }
+    if (start == 0 || now - start >= interval)
+    {
+        // 只有一个线程能切换窗口 由它带出上个窗口的汇总
+        if (windowStart_.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        {
+            count_.store(0, std::memory_order_relaxed);
+            *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        }
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < limit_)
+    {
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
 
 // 获取日志唯一的实例对象 单例
 Logger &Logger::instance()
@@ -10,34 +92,35 @@ Logger &Logger::instance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
+// 写日志 [级别信息] time : msg
+void Logger::log(int level, const char *fmt, ...)
 {
-    logLevel_ = level;
-}
+    const char *pre = levelName(level);
 
-// 写日志 [级别信息] time : msg
-void Logger::log(std::string msg)
-{
-    std::string pre = "";
-    switch (logLevel_)
-    {
-    case INFO:
-        pre = "[INFO]";
-        break;
-    case ERROR:
-        pre = "[ERROR]";
-        break;
-    case FATAL:
-        pre = "[FATAL]";
-        break;
-    case DEBUG:
-        pre = "[DEBUG]";
-        break;
-    default:
-        break;
-    }
-
-    // 打印时间和msg
-    std::cout << pre + Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    // 在栈上拼出一整行 直接格式化进去 交给 output_ 一次写出
+    FixedBuffer<kSmallBuffer> line;
+    line.append(pre, strlen(pre));
+    line.add(Timestamp::now().formatTo(line.current(), false));
+    line.append(" : ", 3);
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line.current(), line.avail() - 1, fmt, args);   // 留一个字节给换行
+    va_end(args);
+    if (n > 0)
+    {
+        line.add(n < line.avail() - 1 ? n : line.avail() - 2);         // 超长时 vsnprintf 已截断
+    }
+
+    // 调用处大多自带 \n 没有的补上
+    if (line.length() == 0 || line.data()[line.length() - 1] != '\n')
+    {
+        line.append("\n", 1);
+    }
+
+    output_(line.data(), line.length(), level);
+    if (level == FATAL)
+    {
+        flush_();
+    }
+}
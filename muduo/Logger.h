@@ -1,62 +1,116 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
 
 #include "noncopyable.h"
+#include "BinaryLogging.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...)                       \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 定义日志的级别 从低到高 低于阈值的日志在格式化之前就被跳过
+enum LogLevel
+{
+    DEBUG, // 调试信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core dump信息
+};
+
+// 编译期的最低级别 低于它的 LOG_* 语句条件恒为假 整条语句被编译器去掉 FATAL 永远保留
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL DEBUG
+#else
+#define MUDUO_MIN_LOG_LEVEL INFO
+#endif
+#endif
+
+// 先比较级别 通过了才格式化 关闭的日志只有一次可预测的分支
+// 启动了 BinaryLogging 时只拷贝参数 格式化交给后端线程 调用点的 siteId 是常量初始化的静态变量 没有额外的初始化检查
+#define LOG_WITH_LEVEL(level, logmsgFormat, ...)                                                         \
+    do                                                                                                   \
+    {                                                                                                    \
+        if ((level) >= MUDUO_MIN_LOG_LEVEL && Logger::logLevel() <= (level))                             \
+        {                                                                                                \
+            if (BinaryLogging::enabled())                                                                \
+            {                                                                                            \
+                static std::atomic<int> logSiteId(-1);                                                   \
+                BinaryLogging::log(logSiteId, (level), __FILE__, __LINE__, logmsgFormat, ##__VA_ARGS__); \
+            }                                                                                            \
+            else                                                                                         \
+            {                                                                                            \
+                Logger::instance().log((level), logmsgFormat, ##__VA_ARGS__);                            \
+            }                                                                                            \
+        }                                                                                                \
     } while (0)
 
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// LOG_INFO("%s %d", arg1, arg2)
+#define LOG_INFO(logmsgFormat, ...) LOG_WITH_LEVEL(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(logmsgFormat, ...) LOG_WITH_LEVEL(ERROR, logmsgFormat, ##__VA_ARGS__)
+#define LOG_DEBUG(logmsgFormat, ...) LOG_WITH_LEVEL(DEBUG, logmsgFormat, ##__VA_ARGS__)
+
+// 限流 每个调用点每 seconds 秒最多输出 n 条 对端异常时每个事件都报错的路径用它
+// 被压掉的条数在下一个时间窗口的第一条之前输出一行汇总
+#define LOG_RATELIMITED(level, n, seconds, logmsgFormat, ...)                                                         \
+    do                                                                                                                \
+    {                                                                                                                 \
+        if ((level) >= MUDUO_MIN_LOG_LEVEL && Logger::logLevel() <= (level))                                          \
+        {                                                                                                             \
+            static LogRateLimiter logRateLimiter((n), (seconds));                                                     \
+            uint64_t logSuppressed = 0;                                                                               \
+            if (logRateLimiter.allow(&logSuppressed))                                                                 \
+            {                                                                                                         \
+                if (logSuppressed > 0)                                                                                \
+                {                                                                                                     \
+                    LOG_WITH_LEVEL(level, "%s:%d suppressed %lu messages\n", __FILE__, __LINE__, logSuppressed);      \
+                }                                                                                                     \
+                LOG_WITH_LEVEL(level, logmsgFormat, ##__VA_ARGS__);                                                   \
+            }                                                                                                         \
+        }                                                                                                             \
     } while (0)
 
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+#define LOG_INFO_RATELIMITED(n, seconds, logmsgFormat, ...) LOG_RATELIMITED(INFO, n, seconds, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR_RATELIMITED(n, seconds, logmsgFormat, ...) LOG_RATELIMITED(ERROR, n, seconds, logmsgFormat, ##__VA_ARGS__)
+
+// 采样 热路径上的 DEBUG 日志平均每 oneIn 次输出一次 级别关闭时连随机数都不取
+#define LOG_DEBUG_SAMPLED(oneIn, logmsgFormat, ...)                                        \
+    do                                                                                     \
+    {                                                                                      \
+        if (DEBUG >= MUDUO_MIN_LOG_LEVEL && Logger::logLevel() <= DEBUG &&                 \
+            Logger::sample(oneIn))                                                         \
+        {                                                                                  \
+            LOG_WITH_LEVEL(DEBUG, logmsgFormat, ##__VA_ARGS__);                            \
+        }                                                                                  \
     } while (0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+#define LOG_FATAL(logmsgFormat, ...)                                  \
+    do                                                                \
+    {                                                                 \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__);   \
+        exit(-1);                                                     \
     } while (0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...)
-#endif
 
-// 定义日志的级别 INFO ERROR FATAL DEBUG
-enum LogLevel
+// LOG_RATELIMITED 每个调用点一个 放在静态存储里 常量初始化 没有查找和初始化检查的开销
+// 时间窗口用 CycleClock 计 窗口长度第一次用到时换算成周期数存下来 之后每次只是整数比较
+// 窗口切换时多个线程同时进入只是计数略有偏差
+class LogRateLimiter
 {
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core dump信息
-    DEBUG, // 调试信息
+public:
+    constexpr LogRateLimiter(int n, int seconds)
+        : limit_(n), seconds_(seconds), intervalCycles_(0), windowStart_(0), count_(0), suppressed_(0) {}
+
+    // 本条可以输出时返回 true 新窗口的第一条通过 suppressed 带回上个窗口被压掉的条数
+    bool allow(uint64_t *suppressed);
+
+private:
+    const int limit_;
+    const int seconds_;
+    std::atomic<uint64_t> intervalCycles_;
+    std::atomic<uint64_t> windowStart_;
+    std::atomic<int> count_;
+    std::atomic<uint64_t> suppressed_;
 };
 
 // 输出一个日志类
@@ -64,13 +118,35 @@ enum LogLevel
 class Logger : noncopyable
 {
 public:
+    // 日志最终输出到哪里 默认写标准输出 可以换成 AsyncLogging::append
+    // level 供输出端按级别处理 比如暂存区满时 ERROR 等待 INFO 丢弃
+    using OutputFunc = std::function<void(const char *msg, int len, int level)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一的实例对象 单例
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行时的日志阈值 任意线程都可以修改 默认 INFO
+    static int logLevel() { return logLevel_.load(std::memory_order_relaxed); }
+    static void setLogLevel(int level) { logLevel_.store(level, std::memory_order_relaxed); }
+
+    // "[INFO]" 等前缀
+    static const char *levelName(int level);
+
+    // 以 1/oneIn 的概率返回 true 每个线程一个 xorshift 生成器
+    static bool sample(uint32_t oneIn);
+
+    // 写日志 由 LOG_* 宏在级别检查通过后调用
+    void log(int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // 在启动时设置 运行中不要修改
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
 
 private:
-    int logLevel_;
-};
\ No newline at end of file
+    Logger();
+
+    static std::atomic<int> logLevel_;
+    OutputFunc output_;
+    FlushFunc flush_;
+};
@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <algorithm>
+
+#include "MirroredBuffer.h"
+#include "Logger.h"
+
+MirroredBuffer::MirroredBuffer(size_t initialSize)
+    : base_(nullptr)
+    , size_(0)
+    , readerIndex_(0)
+    , readable_(0)
+{
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_ = (std::max(initialSize, pageSize) + pageSize - 1) / pageSize * pageSize;
+
+    int fd = ::memfd_create("MirroredBuffer", MFD_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_FATAL("MirroredBuffer memfd_create error:%d\n", errno);
+    }
+    if (::ftruncate(fd, size_) < 0)
+    {
+        LOG_FATAL("MirroredBuffer ftruncate error:%d\n", errno);
+    }
+
+    // 先占住 2*size_ 的连续地址 再把同一个文件固定映射到前后两半
+    void *reserved = ::mmap(nullptr, 2 * size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        LOG_FATAL("MirroredBuffer mmap reserve error:%d\n", errno);
+    }
+    base_ = static_cast<char *>(reserved);
+    if (::mmap(base_, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        ::mmap(base_ + size_, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        LOG_FATAL("MirroredBuffer mmap mirror error:%d\n", errno);
+    }
+    ::close(fd);                 // 映射还在 文件就还在
+}
+
+MirroredBuffer::~MirroredBuffer()
+{
+    ::munmap(base_, 2 * size_);
+}
+
+void MirroredBuffer::append(const char *data, size_t len)
+{
+    ensureWriteableBytes(len);
+    ::memcpy(beginWrite(), data, len);
+    readable_ += len;
+}
+
+void MirroredBuffer::prepend(const void *data, size_t len)
+{
+    ensureWriteableBytes(len);
+    readerIndex_ = readerIndex_ >= len ? readerIndex_ - len : readerIndex_ + size_ - len;
+    readable_ += len;
+    ::memcpy(base_ + readerIndex_, data, len);
+}
+
+void MirroredBuffer::swap(MirroredBuffer &rhs)
+{
+    std::swap(base_, rhs.base_);
+    std::swap(size_, rhs.size_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(readable_, rhs.readable_);
+}
+
+void MirroredBuffer::grow(size_t len)
+{
+    size_t newSize = size_ * 2;
+    while (newSize < len)
+    {
+        newSize *= 2;
+    }
+    MirroredBuffer other(newSize);
+    other.append(peek(), readable_);
+    swap(other);
+}
+
+// 和 Buffer::readFd 一样 先读进可写空间 多出来的落到栈上的 64K extrabuf 再扩容
+ssize_t MirroredBuffer::readFd(int fd, int *saveErrno)
+{
+    char extrabuf[65536];
+
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (static_cast<size_t>(n) <= writable)
+    {
+        readable_ += n;
+    }
+    else
+    {
+        readable_ += writable;
+        append(extrabuf, n - writable);
+    }
+    return n;
+}
+
+ssize_t MirroredBuffer::writeFd(int fd, int *saveErrno)
+{
+    ssize_t n = ::write(fd, peek(), readableBytes());
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
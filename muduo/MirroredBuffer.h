@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+/**
+ * 虚拟内存镜像的环形缓冲
+ * 用 memfd_create 建一块共享内存 在地址空间里连续映射两次 [base, base+size) 和 [base+size, base+2*size) 是同一组物理页
+ * 所以从任何位置开始的 size 字节以内都是连续的 可读数据和可写空间永远不需要 memmove 也不会因为回绕而分成两段
+ * 接口与 Buffer 一致 可以直接替换连接的输入输出缓冲 空间不够时换一块两倍大的
+ * 物理页在第一次写入时才分配 空闲连接只占用虚拟地址空间
+ **/
+class MirroredBuffer : noncopyable
+{
+public:
+    static const size_t kInitialSize = 64 * 1024;
+
+    // 大小向上取整为页大小的整数倍
+    explicit MirroredBuffer(size_t initialSize = kInitialSize);
+    ~MirroredBuffer();
+
+    size_t readableBytes() const { return readable_; }
+    size_t writableBytes() const { return size_ - readable_; }
+    size_t capacity() const { return size_; }
+
+    // 返回缓冲区中可读数据的起始地址 之后的 readableBytes() 字节是连续的
+    const char *peek() const { return base_ + readerIndex_; }
+
+    void retrieve(size_t len)
+    {
+        if (len < readable_)
+        {
+            readerIndex_ += len;
+            if (readerIndex_ >= size_)
+            {
+                readerIndex_ -= size_;   // 落到第二份映射里了 换回第一份的同一位置
+            }
+            readable_ -= len;
+        }
+        else
+        {
+            retrieveAll();
+        }
+    }
+
+    // 可读数据清空时回到开头 下一次读写尽量落在已经分配的物理页上
+    void retrieveAll()
+    {
+        readerIndex_ = 0;
+        readable_ = 0;
+    }
+
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+
+    std::string retrieveAsString(size_t len)
+    {
+        std::string result(peek(), len);
+        retrieve(len);
+        return result;
+    }
+
+    void ensureWriteableBytes(size_t len)
+    {
+        if (writableBytes() < len)
+        {
+            grow(readable_ + len);
+        }
+    }
+
+    void append(const char *data, size_t len);
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    // 之后的 writableBytes() 字节是连续的
+    char *beginWrite() { return base_ + readerIndex_ + readable_; }
+    const char *beginWrite() const { return base_ + readerIndex_ + readable_; }
+
+    void hasWritten(size_t len) { readable_ += len; }
+
+    // 在可读数据前面填入 len 字节 环形缓冲只要还有空间就可以往前写
+    void prepend(const void *data, size_t len);
+
+    void swap(MirroredBuffer &rhs);
+
+    // 从fd上读取数据
+    ssize_t readFd(int fd, int *saveErrno);
+    // 通过fd发送数据
+    ssize_t writeFd(int fd, int *saveErrno);
+
+private:
+    void grow(size_t len);
+
+    char *base_;                 // 两份映射的起始地址
+    size_t size_;                // 一份映射的大小
+    size_t readerIndex_;         // [0, size_)
+    size_t readable_;
+};
@@ -0,0 +1,93 @@
+#include "Rcu.h"
+#include "EventLoop.h"
+
+RcuDomain &RcuDomain::instance()
+{
+    static RcuDomain domain;
+    return domain;
+}
+
+void RcuDomain::registerLoop(EventLoop *loop, const std::atomic<uint64_t> *state)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    loops_[loop] = state;
+}
+
+void RcuDomain::unregisterLoop(EventLoop *loop)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        loops_.erase(loop);
+    }
+    reclaim();                               // 可能只差这个 loop 了
+}
+
+void RcuDomain::retire(Deleter deleter)
+{
+    // 与 EventLoop 上线时的 fence 配对：快照中处于离线状态的 loop 上线后一定能读到新版本
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Retired retired;
+        retired.snapshot.reserve(loops_.size());
+        for(const auto &item : loops_)
+        {
+            retired.snapshot.emplace_back(item.first, item.second->load(std::memory_order_acquire));
+        }
+        retired.deleter = std::move(deleter);
+        retired_.push_back(std::move(retired));
+        retiredCount_.store(retired_.size(), std::memory_order_relaxed);
+    }
+
+    // 与 EventLoop 离线后的 fence 配对：要么这里读到它离线后的计数器 要么它在 quiescent 中读到 retiredCount_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    reclaim();
+}
+
+// 调用时持有 mutex_
+bool RcuDomain::gracePassed(const Retired &retired) const
+{
+    for(const auto &item : retired.snapshot)
+    {
+        if(item.second & 1)                  // 当时处于离线状态
+        {
+            continue;
+        }
+        auto it = loops_.find(item.first);
+        if(it != loops_.end() && it->second->load(std::memory_order_acquire) == item.second)
+        {
+            return false;                    // 还在当时那一轮循环里
+        }
+    }
+    return true;
+}
+
+size_t RcuDomain::reclaim()
+{
+    std::vector<Deleter> deleters;
+    size_t remaining = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<Retired> pending;
+        for(Retired &retired : retired_)
+        {
+            if(gracePassed(retired))
+            {
+                deleters.push_back(std::move(retired.deleter));
+            }
+            else
+            {
+                pending.push_back(std::move(retired));
+            }
+        }
+        retired_.swap(pending);
+        remaining = retired_.size();
+        retiredCount_.store(remaining, std::memory_order_relaxed);
+    }
+
+    for(const Deleter &deleter : deleters)
+    {
+        deleter();
+    }
+    return remaining;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "noncopyable.h"
+
+class EventLoop;
+
+/**
+ * 基于静止状态(QSBR)的 RCU 回收
+ * 每个 EventLoop 在阻塞于 poll 之前把自己的计数器加一置为奇数(离线 即本轮循环已结束) poll 返回后再加一置为偶数(在线)
+ * 写者发布新版本后把旧版本交给 retire 记下此时各 loop 的计数器
+ * 等每个 loop 都离线过或者计数器变化过 说明它们都已结束了当时所在的那轮循环 旧版本不再被引用 可以释放
+ * 检查由 retire 和各 loop 每轮阻塞于 poll 之前的 quiescent 完成 最后一个经过静止点的 loop 负责释放
+ * 写者可以在任意线程 没有等待回收的旧版本时 quiescent 只是一次原子读取
+ **/
+class RcuDomain : noncopyable
+{
+public:
+    using Deleter = std::function<void()>;
+
+    static RcuDomain &instance();
+
+    // EventLoop 构造/析构时调用
+    void registerLoop(EventLoop *loop, const std::atomic<uint64_t> *state);
+    void unregisterLoop(EventLoop *loop);
+
+    // 在所有 loop 经过静止点之后调用 deleter 可在任意线程调用
+    void retire(Deleter deleter);
+
+    // 释放已经过了宽限期的旧版本 返回还在等待的个数
+    size_t reclaim();
+
+    // EventLoop 每轮离线之后 阻塞于 poll 之前调用
+    void quiescent()
+    {
+        if (retiredCount_.load(std::memory_order_relaxed) > 0)
+        {
+            reclaim();
+        }
+    }
+
+private:
+    struct Retired
+    {
+        std::vector<std::pair<EventLoop*, uint64_t>> snapshot;
+        Deleter deleter;
+    };
+
+    RcuDomain() : retiredCount_(0) {}
+    bool gracePassed(const Retired &retired) const;
+
+    std::mutex mutex_;
+    std::unordered_map<EventLoop*, const std::atomic<uint64_t>*> loops_;
+    std::vector<Retired> retired_;
+    std::atomic<size_t> retiredCount_;     // retired_.size() 持锁写 loop 不加锁读
+};
+
+/**
+ * 读多写少的共享数据(路由表 配置等)
+ * 读者在 EventLoop 线程中调用 get() 只是一次普通的指针读取 没有锁和原子读改写
+ * 拿到的快照在本轮 loop 结束前有效 不要跨轮次保存
+ * 写者 update() 发布新版本 旧版本由 RcuDomain 在所有 loop 经过静止点后释放
+ **/
+template <typename T>
+class Shared : noncopyable
+{
+public:
+    explicit Shared(T value = T())
+        : current_(new T(std::move(value)))
+    {
+    }
+
+    // 析构时不能再有读者
+    ~Shared() { delete current_.load(std::memory_order_relaxed); }
+
+    const T *get() const { return current_.load(std::memory_order_acquire); }
+    const T &operator*() const { return *get(); }
+    const T *operator->() const { return get(); }
+
+    // 可在任意线程调用
+    void update(T value)
+    {
+        T *next = new T(std::move(value));
+        T *prev = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(writeMutex_);
+            prev = current_.load(std::memory_order_relaxed);
+            current_.store(next, std::memory_order_release);
+        }
+        RcuDomain::instance().retire([prev]() { delete prev; });
+    }
+
+private:
+    std::atomic<T*> current_;
+    std::mutex writeMutex_;        // 多个写者之间互斥
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "EventLoop.h"
+#include "Logger.h"
+
+/**
+ * shared-nothing 分片模型：每个 loop 拥有一份数据分片 通过 submitTo 在其他分片所在的 loop 上执行操作
+ *
+ *     submitTo(targetLoop, [] { return shard.lookup(key); })
+ *         .then([](Value v) { ... });      // 回到调用 submitTo 的 loop 上执行
+ *
+ * 请求和应答都经过 EventLoop::sendTo 的 SPSC 队列
+ * 共享状态的内容只在调用方 loop 线程中访问 由 future 和在途的请求/应答共同持有(shared_ptr 原子计数)
+ * 消息没能执行就被丢弃(比如一端的 loop 已经析构 队列被清掉)时 在丢弃它的线程中释放自己那一份 不会泄漏
+ **/
+
+namespace detail
+{
+    template <typename T>
+    struct ShardState : noncopyable
+    {
+        using Continuation = std::function<void(T)>;
+
+        ShardState() : ready(false), value() {}
+
+        void setValue(T v)
+        {
+            if(continuation)
+            {
+                continuation(std::move(v));
+            }
+            else
+            {
+                value = std::move(v);
+                ready = true;
+            }
+        }
+
+        void then(Continuation cb)
+        {
+            if(ready)
+            {
+                ready = false;
+                cb(std::move(value));
+            }
+            else
+            {
+                continuation = std::move(cb);
+            }
+        }
+
+        bool ready;
+        T value;
+        Continuation continuation;
+    };
+
+    template <>
+    struct ShardState<void> : noncopyable
+    {
+        using Continuation = std::function<void()>;
+
+        ShardState() : ready(false) {}
+
+        void setValue()
+        {
+            if(continuation)
+            {
+                continuation();
+            }
+            else
+            {
+                ready = true;
+            }
+        }
+
+        void then(Continuation cb)
+        {
+            if(ready)
+            {
+                ready = false;
+                cb();
+            }
+            else
+            {
+                continuation = std::move(cb);
+            }
+        }
+
+        bool ready;
+        Continuation continuation;
+    };
+
+    // 在 targetLoop 中执行 fn 再把结果发回 sourceLoop
+    template <typename T>
+    struct ShardCall
+    {
+        template <typename F>
+        static void run(const F &fn, EventLoop *sourceLoop, EventLoop *targetLoop, const std::shared_ptr<ShardState<T>> &state)
+        {
+            T result = fn();
+            targetLoop->sendTo(sourceLoop, std::bind([state](T &v) {
+                state->setValue(std::move(v));
+            }, std::move(result)));
+        }
+    };
+
+    template <>
+    struct ShardCall<void>
+    {
+        template <typename F>
+        static void run(const F &fn, EventLoop *sourceLoop, EventLoop *targetLoop, const std::shared_ptr<ShardState<void>> &state)
+        {
+            fn();
+            targetLoop->sendTo(sourceLoop, [state]() {
+                state->setValue();
+            });
+        }
+    };
+}
+
+// submitTo 返回的句柄 只能在调用 submitTo 的 loop 线程中使用
+template <typename T>
+class ShardFuture
+{
+public:
+    using Continuation = typename detail::ShardState<T>::Continuation;
+
+    explicit ShardFuture(std::shared_ptr<detail::ShardState<T>> state) : state_(std::move(state)) {}
+    ShardFuture(ShardFuture &&rhs) : state_(std::move(rhs.state_)) {}
+
+    ShardFuture(const ShardFuture &) = delete;
+    ShardFuture &operator=(const ShardFuture &) = delete;
+
+    bool ready() const { return state_->ready; }
+
+    // 结果已经返回则立即执行 否则在结果返回时于本 loop 中执行
+    void then(Continuation cb) { state_->then(std::move(cb)); }
+
+private:
+    std::shared_ptr<detail::ShardState<T>> state_;
+};
+
+// 在调用方 loop 线程中调用 在 targetLoop 上执行 fn
+template <typename F>
+ShardFuture<typename std::result_of<F()>::type> submitTo(EventLoop *targetLoop, F fn)
+{
+    using T = typename std::result_of<F()>::type;
+
+    EventLoop *sourceLoop = EventLoop::loopOfCurrentThread();
+    if(sourceLoop == nullptr)
+    {
+        LOG_FATAL("submitTo must be called in an EventLoop thread\n");
+    }
+
+    std::shared_ptr<detail::ShardState<T>> state(new detail::ShardState<T>());
+    sourceLoop->sendTo(targetLoop, [fn, sourceLoop, targetLoop, state]() {
+        detail::ShardCall<T>::run(fn, sourceLoop, targetLoop, state);
+    });
+    return ShardFuture<T>(state);
+}
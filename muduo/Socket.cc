@@ -3,7 +3,10 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
+#include <linux/filter.h>
+#include <errno.h>
 
 #include "Socket.h"
 #include "Logger.h"
@@ -22,9 +25,9 @@ void Socket::bindAddress(const InetAddress &localaddr)
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 {
-    if (0 != ::listen(sockfd_, 1024))
+    if (0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL("listen sockfd:%d fail\n", sockfd_);
     }
@@ -83,3 +86,109 @@ void Socket::setKeepAlive(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval)); // TCP_NODELAY包含头文件 <netinet/tcp.h>
 }
+
+// 设置一个 int 类型的选项 失败只记录日志
+static void setIntOption(int sockfd, int level, int optname, int value, const char *name)
+{
+    if (::setsockopt(sockfd, level, optname, &value, sizeof value) < 0)
+    {
+        LOG_ERROR("setsockopt %s sockfd:%d error:%d\n", name, sockfd, errno);
+    }
+}
+
+void Socket::setDeferAccept(int seconds)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "TCP_DEFER_ACCEPT");
+}
+
+void Socket::setFastOpen(int qlen)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, qlen, "TCP_FASTOPEN");
+}
+
+void Socket::setQuickAck(bool on)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0, "TCP_QUICKACK");
+}
+
+void Socket::setRecvBufferSize(int bytes)
+{
+    setIntOption(sockfd_, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+
+void Socket::setSendBufferSize(int bytes)
+{
+    setIntOption(sockfd_, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+
+void Socket::setNotSentLowat(int bytes)
+{
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes, "TCP_NOTSENT_LOWAT");
+}
+
+void Socket::setMaxPacingRate(uint64_t bytesPerSecond)
+{
+    // 内核既接受 32 位也接受 64 位的值 超过 32 位时传 64 位
+    int ret;
+    if (bytesPerSecond <= UINT32_MAX)
+    {
+        uint32_t rate = static_cast<uint32_t>(bytesPerSecond);
+        ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof rate);
+    }
+    else
+    {
+        ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_MAX_PACING_RATE, &bytesPerSecond, sizeof bytesPerSecond);
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("setsockopt SO_MAX_PACING_RATE sockfd:%d error:%d\n", sockfd_, errno);
+    }
+}
+
+bool Socket::setReusePortCpuSteering(int groupSize)
+{
+    // A = 当前 CPU; A = A % groupSize; return A  返回值是组内 socket 的下标
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<__u32>(groupSize)},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof code / sizeof code[0];
+    prog.filter = code;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+    {
+        LOG_ERROR("setReusePortCpuSteering sockfd:%d error:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("setsockopt SO_ZEROCOPY sockfd:%d error:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setUdpGro(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_UDP, UDP_GRO, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("setsockopt UDP_GRO sockfd:%d error:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::udpGsoSupported() const
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    return ::getsockopt(sockfd_, SOL_UDP, UDP_SEGMENT, &optval, &optlen) == 0;
+}
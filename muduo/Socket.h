@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "noncopyable.h"
 
 class InetAddress;
@@ -8,6 +10,8 @@ class InetAddress;
 class Socket : noncopyable
 {
 public:
+    static const int kDefaultBacklog = 1024;
+
     explicit Socket(int sockfd)
     : sockfd_(sockfd)
     {}
@@ -16,7 +20,7 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &localaddr);
-    void listen();
+    void listen(int backlog = kDefaultBacklog);
     int accept(InetAddress* peeraddr);
 
     void shutdownWrite();
@@ -26,6 +30,27 @@ public:
     void setReuseAddr(bool on);   
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+
+    // 以下失败时只记录日志 不影响连接 内核不支持的选项相当于没设置
+    // listen socket: 连接上有数据到达(最多等 seconds 秒)才从 accept 返回 不会为只握手不发数据的连接唤醒 loop
+    void setDeferAccept(int seconds);
+    // listen socket: 开启 TCP Fast Open qlen 是还没完成握手的 TFO 请求队列长度 首个请求少一个往返
+    void setFastOpen(int qlen);
+    void setQuickAck(bool on);                 // 立即回 ACK 不走延迟确认 内核会自动复位 需要时每次读后再设置
+    void setRecvBufferSize(int bytes);         // listen socket 上设置 accept 出来的连接会继承 要在 listen 之前设置
+    void setSendBufferSize(int bytes);
+    void setNotSentLowat(int bytes);           // 未发送的数据低于这个值才报告可写 减少发送缓冲里积压的数据
+    void setMaxPacingRate(uint64_t bytesPerSecond);
+
+    // 同一个 SO_REUSEPORT 组里 按处理该包的 CPU 选择第 (cpu % groupSize) 个 listen 的 socket
+    // 给组里任意一个 socket 设置一次即可 失败返回 false
+    bool setReusePortCpuSteering(int groupSize);
+    // SO_ZEROCOPY 之后才能用 MSG_ZEROCOPY 发送 内核不支持时返回 false
+    bool setZeroCopy(bool on);
+
+    // UDP 选项 内核不支持时返回 false
+    bool setUdpGro(bool on);                   // 接收端把同一条流的多个数据报合并成一个 cmsg 带回每段长度
+    bool udpGsoSupported() const;              // 发送时能否用 UDP_SEGMENT 让内核切分数据报
 private:
     const int sockfd_;
 };
\ No newline at end of file
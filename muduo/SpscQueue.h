@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/**
+ * 单生产者单消费者的环形队列
+ * 生产者只写 tail_ 消费者只写 head_ 双方对对方的下标只做 acquire 读 不需要锁也不需要原子的读改写操作
+ * 各自缓存一份对方的下标 只有在看起来满/空时才去读对方的 cache line
+ **/
+template <typename T>
+class SpscQueue : noncopyable
+{
+public:
+    // 容量向上取整为 2 的幂 用 & mask_ 代替取模
+    explicit SpscQueue(size_t capacity)
+        : head_(0)
+        , cachedTail_(0)
+        , tail_(0)
+        , cachedHead_(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // 生产者线程调用 队列满时返回 false 且不会移走 v
+    bool push(T &&v)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_)
+            {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者线程调用 队列空时返回 false
+    bool pop(T &v)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+            {
+                return false;
+            }
+        }
+        v = std::move(buffer_[head & mask_]);
+        buffer_[head & mask_] = T();          // 尽早释放元素持有的资源
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者线程调用
+    bool empty() const { return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    static const size_t kCacheLineSize = 64;
+
+    std::vector<T> buffer_;
+    size_t mask_;
+
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> head_;       // 消费者写
+    size_t cachedTail_;              // 消费者本地缓存的 tail_
+
+    char pad1_[kCacheLineSize];
+    std::atomic<size_t> tail_;       // 生产者写
+    size_t cachedHead_;              // 生产者本地缓存的 head_
+    char pad2_[kCacheLineSize];
+};
@@ -0,0 +1,816 @@
+#include <functional>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "TcpConnection.h"
+#include "Logger.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "EventLoop.h"
+
+namespace
+{
+    // 对端已经关闭时 write 会产生 SIGPIPE 默认动作是结束进程 服务器要忽略它 靠 EPIPE 处理
+    struct IgnoreSigPipe
+    {
+        IgnoreSigPipe() { ::signal(SIGPIPE, SIG_IGN); }
+    };
+    IgnoreSigPipe ignoreSigPipe;
+
+    const size_t kDefaultHighWaterMark = 64 * 1024 * 1024;
+}
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d TcpConnection Loop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                             const std::string &nameArg,
+                             int sockfd,
+                             const InetAddress &localAddr,
+                             const InetAddress &peerAddr)
+    : loop_(CheckLoopNotNull(loop))
+    , name_(nameArg)
+    , state_(kConnecting)
+    , reading_(true)
+    , coalesceWrites_(false)
+    , flushScheduled_(false)
+    , socket_(new Socket(sockfd))
+    , channel_(new Channel(loop, sockfd))
+    , localAddr_(localAddr)
+    , peerAddr_(peerAddr)
+    , highWaterMark_(kDefaultHighWaterMark)
+    , zeroCopyThreshold_(kDefaultZeroCopyThreshold)
+    , zeroCopyState_(kZeroCopyOff)
+    , zeroCopySeq_(0)
+    , bytesReceived_(0)
+    , migrating_(false)
+    , ownerFunctorsQueued_(false)
+{
+    // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的操作函数
+    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
+    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
+    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+
+    LOG_DEBUG("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    socket_->setKeepAlive(true);
+}
+
+TcpConnection::~TcpConnection()
+{
+    LOG_DEBUG("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(), (int)state_);
+    for (const PendingSegment &segment : pendingSegments_)
+    {
+        if (segment.fd >= 0)
+        {
+            ::close(segment.fd);
+        }
+    }
+}
+
+void TcpConnection::send(const std::string &buf)
+{
+    send(buf.data(), buf.size());
+}
+
+void TcpConnection::send(const char *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            // 跨线程发送 数据要拷贝一份 调用返回后 data 可能已经失效
+            auto self = shared_from_this();
+            std::string message(data, len);
+            runInOwnerLoop([self, message]() { self->sendInLoop(message.data(), message.size()); });
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected && len > 0)
+    {
+        // dup 一份 调用方可以马上关闭自己的 fd 发送完或者连接销毁时关闭这一份
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d errno:%d\n", fd, errno);
+            return;
+        }
+        if (inOwnerLoop())
+        {
+            sendFileInLoop(fileFd, offset, len);
+        }
+        else
+        {
+            runInOwnerLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileFd, offset, len));
+        }
+    }
+}
+
+void TcpConnection::sendZeroCopy(const ChainBuffer::Block &block)
+{
+    if (state_ == kConnected && block && !block->empty())
+    {
+        if (inOwnerLoop())
+        {
+            sendZeroCopyInLoop(block);
+        }
+        else
+        {
+            runInOwnerLoop(std::bind(&TcpConnection::sendZeroCopyInLoop, shared_from_this(), block));
+        }
+    }
+}
+
+void TcpConnection::send(ChainBuffer *buf)
+{
+    if (state_ == kConnected && buf->readableBytes() > 0)
+    {
+        // 分片只是引用 换出来交给 loop 调用方的 buf 可以马上复用
+        std::shared_ptr<ChainBuffer> chain(new ChainBuffer);
+        chain->swap(*buf);
+        if (inOwnerLoop())
+        {
+            sendChainInLoop(chain);
+        }
+        else
+        {
+            runInOwnerLoop(std::bind(&TcpConnection::sendChainInLoop, shared_from_this(), chain));
+        }
+    }
+}
+
+/**
+ * 发送数据  应用写的快 而内核发送数据慢 需要把待发送数据写入缓冲区 而且设置了水位回调
+ **/
+void TcpConnection::sendInLoop(const char *data, size_t len)
+{
+    if (!inOwnerLoop())
+    {
+        auto self = shared_from_this();
+        std::string message(data, len);
+        runInOwnerLoop([self, message]() { self->sendInLoop(message.data(), message.size()); });
+        return;
+    }
+
+    ssize_t nwrote = 0;
+    size_t remaining = len;
+    bool faultError = false;
+
+    // 之前调用过该connection的shutdown 不能再进行发送了
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!\n");
+        return;
+    }
+
+    // 前面还有文件或者零拷贝的块没发完 数据挂到最后一段后面 保证发送顺序 这时一定在等 EPOLLOUT 或者本轮末尾的 flushCoalesced
+    if (!pendingSegments_.empty())
+    {
+        Buffer &trailer = pendingSegments_.back().trailer;
+        size_t oldLen = outputBuffer_.readableBytes() + trailer.readableBytes();
+        if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        {
+            getLoop()->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+        }
+        trailer.append(data, len);
+        return;
+    }
+
+    // 写合并 先攒在 outputBuffer_ 里 本轮末尾一次写出 已经在等 EPOLLOUT 的话由 handleWrite 一起写
+    if (coalesceWrites_)
+    {
+        size_t oldLen = outputBuffer_.readableBytes();
+        if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        {
+            getLoop()->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+        }
+        outputBuffer_.append(data, len);
+        if (!flushScheduled_ && !channel_->isWriting())
+        {
+            flushScheduled_ = true;
+            getLoop()->runAfterIteration(std::bind(&TcpConnection::flushCoalesced, shared_from_this()));
+        }
+        return;
+    }
+
+    // 表示channel_第一次开始写数据 而且缓冲区没有待发送数据 直接写 省一次拷贝
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        nwrote = ::write(channel_->fd(), data, len);
+        if (nwrote >= 0)
+        {
+            remaining = len - nwrote;
+            if (remaining == 0 && writeCompleteCallback_)
+            {
+                // 既然在这里数据全部发送完成 就不用再给channel设置epollout事件了
+                getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+        }
+        else                     // nwrote < 0
+        {
+            nwrote = 0;
+            if (errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("TcpConnection::sendInLoop errno:%d\n", errno);
+                if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE  RESET
+                {
+                    faultError = true;
+                }
+            }
+        }
+    }
+
+    /**
+     * 说明当前这一次write 并没有把数据全部发送出去 剩余的数据需要保存到缓冲区当中
+     * 然后给channel注册epollout事件 poller发现tcp的发送缓冲区有空间 会通知相应的sock-channel 调用writeCallback_回调方法
+     * 也就是调用TcpConnection::handleWrite方法 把发送缓冲区中的数据全部发送完成
+     **/
+    if (!faultError && remaining > 0)
+    {
+        // 目前发送缓冲区剩余的待发送数据的长度 只在越过高水位的那一次回调
+        size_t oldLen = outputBuffer_.readableBytes();
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        {
+            getLoop()->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+        }
+        outputBuffer_.append(data + nwrote, remaining);
+        if (!channel_->isWriting())
+        {
+            channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+        }
+    }
+}
+
+// 本轮循环末尾执行 把这一轮攒下的数据一次写出 写不完的再关注写事件
+void TcpConnection::flushCoalesced()
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::flushCoalesced, shared_from_this()));   // 登记后连接迁走了
+        return;
+    }
+    flushScheduled_ = false;
+    if (state_ == kDisconnected || channel_->isWriting()
+        || (outputBuffer_.readableBytes() == 0 && pendingSegments_.empty()))
+    {
+        return;
+    }
+
+    if (writePending())
+    {
+        writeDrained();
+    }
+    else
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, len));
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up sending file!\n");
+        ::close(fd);
+        return;
+    }
+
+    PendingSegment segment;
+    segment.fd = fd;
+    segment.offset = offset;
+    segment.remaining = len;
+    queueSegment(std::move(segment));
+}
+
+void TcpConnection::sendZeroCopyInLoop(const ChainBuffer::Block &block)
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::sendZeroCopyInLoop, shared_from_this(), block));
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!\n");
+        return;
+    }
+
+    // 第一次遇到够大的块时才打开 SO_ZEROCOPY
+    if (zeroCopyState_ == kZeroCopyOff && block->size() >= zeroCopyThreshold_)
+    {
+        zeroCopyState_ = socket_->setZeroCopy(true) ? kZeroCopyOn : kZeroCopyFallback;
+    }
+    if (zeroCopyState_ != kZeroCopyOn || block->size() < zeroCopyThreshold_)
+    {
+        sendInLoop(block->data(), block->size());
+        return;
+    }
+
+    PendingSegment segment;
+    segment.block = block;
+    segment.remaining = block->size();
+    queueSegment(std::move(segment));
+}
+
+void TcpConnection::sendChainInLoop(const std::shared_ptr<ChainBuffer> &chain)
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::sendChainInLoop, shared_from_this(), chain));
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!\n");
+        return;
+    }
+
+    PendingSegment segment;
+    segment.chain = chain;
+    segment.remaining = chain->readableBytes();
+    queueSegment(std::move(segment));
+}
+
+void TcpConnection::queueSegment(PendingSegment &&segment)
+{
+    pendingSegments_.push_back(std::move(segment));
+
+    // 已经在等 EPOLLOUT 或者本轮末尾的 flushCoalesced 这一段排在后面由它们发送
+    if (channel_->isWriting() || flushScheduled_)
+    {
+        return;
+    }
+    if (writePending())
+    {
+        writeDrained();
+    }
+    else
+    {
+        channel_->enableWriting();
+    }
+}
+
+/**
+ * 依次写 outputBuffer_ 和排队的文件/数据块 直到全部写完或者内核发送缓冲区满
+ * 一段发完后 它的 trailer 换进 outputBuffer_ 接着写
+ * 返回 true 表示全部写完 出错时记日志返回 false 由读事件或者下一次 EPOLLOUT 走关闭流程
+ **/
+bool TcpConnection::writePending()
+{
+    int sockfd = channel_->fd();
+    while (true)
+    {
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            int savedErrno = 0;
+            ssize_t n = outputBuffer_.writeFd(sockfd, &savedErrno);
+            if (n < 0)
+            {
+                if (savedErrno != EWOULDBLOCK)
+                {
+                    LOG_ERROR_RATELIMITED(5, 1, "TcpConnection::writePending errno:%d\n", savedErrno);
+                }
+                return false;
+            }
+            outputBuffer_.retrieve(n);
+            if (outputBuffer_.readableBytes() > 0)
+            {
+                return false;    // 内核发送缓冲区满了
+            }
+        }
+        if (pendingSegments_.empty())
+        {
+            return true;
+        }
+
+        PendingSegment &segment = pendingSegments_.front();
+        while (segment.remaining > 0)
+        {
+            ssize_t n = sendSegment(segment);
+            if (n > 0)
+            {
+                segment.remaining -= n;
+                continue;
+            }
+            if (n < 0 && errno == EAGAIN)
+            {
+                return false;
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            // n == 0 文件比 len 短 或者出错 都放弃这一段剩下的部分
+            if (n < 0)
+            {
+                LOG_ERROR_RATELIMITED(5, 1, "TcpConnection::writePending errno:%d\n", errno);
+            }
+            else
+            {
+                LOG_ERROR("TcpConnection::writePending file fd=%d ended %zu bytes early\n", segment.fd, segment.remaining);
+            }
+            break;
+        }
+        if (segment.fd >= 0)
+        {
+            ::close(segment.fd);
+        }
+        outputBuffer_.swap(segment.trailer);
+        pendingSegments_.pop_front();
+    }
+}
+
+// 发送排队的一段 文件走 sendfile 分片链走 writev 数据块打开了零拷贝就带 MSG_ZEROCOPY 返回值和 write 一样
+ssize_t TcpConnection::sendSegment(PendingSegment &segment)
+{
+    int sockfd = channel_->fd();
+    if (segment.fd >= 0)
+    {
+        return ::sendfile(sockfd, segment.fd, &segment.offset, segment.remaining);
+    }
+    if (segment.chain)
+    {
+        int savedErrno = 0;
+        ssize_t n = segment.chain->writeFd(sockfd, &savedErrno);   // 写出的部分已经从链上取走
+        if (n < 0)
+        {
+            errno = savedErrno;
+        }
+        return n;
+    }
+
+    const char *data = segment.block->data() + segment.offset;
+    int flags = zeroCopyState_ == kZeroCopyOn ? MSG_ZEROCOPY : 0;
+    ssize_t n = ::send(sockfd, data, segment.remaining, flags);
+    if (n < 0 && errno == ENOBUFS && flags != 0)
+    {
+        // 没取走的完成通知占满了 optmem 这一次先拷贝发送
+        flags = 0;
+        n = ::send(sockfd, data, segment.remaining, flags);
+    }
+    if (n > 0)
+    {
+        // 每次成功的 MSG_ZEROCOPY 发送 内核的序号加一 块要留到这个序号的完成通知到达
+        if (flags != 0)
+        {
+            zeroCopyInFlight_.emplace_back(zeroCopySeq_++, segment.block);
+        }
+        segment.offset += n;
+    }
+    return n;
+}
+
+// 取完错误队列里的零拷贝完成通知 释放已经发送完成的数据块
+void TcpConnection::handleZeroCopyCompletions()
+{
+    char control[128];
+    while (true)
+    {
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE) < 0)
+        {
+            break;               // EAGAIN 错误队列已经取空
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+            const struct sock_extended_err *err = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cmsg));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0)
+            {
+                continue;
+            }
+            // [ee_info, ee_data] 这些序号的发送已经完成 TCP 的通知是按序的 释放到 ee_data 为止
+            uint32_t last = err->ee_data;
+            while (!zeroCopyInFlight_.empty() && static_cast<int32_t>(zeroCopyInFlight_.front().first - last) <= 0)
+            {
+                zeroCopyInFlight_.pop_front();
+            }
+            if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && zeroCopyState_ == kZeroCopyOn)
+            {
+                // 内核还是拷贝了 零拷贝只多了通知的开销
+                LOG_INFO("TcpConnection::handleZeroCopyCompletions [%s] kernel copied, fall back to send\n", name_.c_str());
+                zeroCopyState_ = kZeroCopyFallback;
+            }
+        }
+    }
+}
+
+// 发送缓冲区的数据和文件都写完了
+void TcpConnection::writeDrained()
+{
+    if (writeCompleteCallback_)
+    {
+        getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::shutdown()
+{
+    if (state_ == kConnected)
+    {
+        setState(kDisconnecting);
+        if (inOwnerLoop())
+        {
+            shutdownInLoop();
+        }
+        else
+        {
+            runInOwnerLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        }
+    }
+}
+
+void TcpConnection::shutdownInLoop()
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        return;
+    }
+    // 说明outputBuffer中的数据已经全部发送完成 写合并时可能还没开始写 排队的文件也要发完
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && pendingSegments_.empty())
+    {
+        socket_->shutdownWrite(); // 关闭写端
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setQuickAck(bool on)
+{
+    socket_->setQuickAck(on);
+}
+
+void TcpConnection::startRead()
+{
+    if (inOwnerLoop())
+    {
+        startReadInLoop();
+    }
+    else
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    if (inOwnerLoop())
+    {
+        stopReadInLoop();
+    }
+    else
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+        return;
+    }
+    if (!reading_ || !channel_->isReading())
+    {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+        return;
+    }
+    if (reading_ || channel_->isReading())
+    {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
+// 连接建立
+void TcpConnection::connectEstablished()
+{
+    setState(kConnected);
+    channel_->tie(shared_from_this());
+    channel_->enableReading();   // 向poller注册channel的epollin事件
+
+    // 新连接建立 执行回调
+    if (connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
+}
+
+// 连接销毁
+void TcpConnection::connectDestroyed()
+{
+    if (!inOwnerLoop())
+    {
+        runInOwnerLoop(std::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+        return;
+    }
+    if (state_ == kConnected)
+    {
+        setState(kDisconnected);
+        channel_->disableAll();  // 把channel的所有感兴趣的事件 从poller中del掉
+        if (connectionCallback_)
+        {
+            connectionCallback_(shared_from_this());
+        }
+    }
+    channel_->remove();          // 把channel从poller中删除掉
+}
+
+void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    int savedErrno = 0;
+    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (n > 0)
+    {
+        bytesReceived_.store(bytesReceived_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        // 已建立连接的用户 有可读事件发生了 调用用户传入的回调操作onMessage
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    else if (n == 0)
+    {
+        handleClose();
+    }
+    else
+    {
+        errno = savedErrno;
+        LOG_ERROR_RATELIMITED(5, 1, "TcpConnection::handleRead errno:%d\n", savedErrno);
+        handleError();
+    }
+}
+
+void TcpConnection::handleWrite()
+{
+    if (channel_->isWriting())
+    {
+        if (writePending())
+        {
+            channel_->disableWriting();  // 写完了 不再关注写事件 否则 LT 模式下会一直触发
+            writeDrained();
+        }
+    }
+    else
+    {
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing\n", channel_->fd());
+    }
+}
+
+bool TcpConnection::migrateTo(EventLoop *targetLoop, const MigratedCallback &cb)
+{
+    // 正在关闭的连接也可以迁移 shutdown 会在新 loop 上完成
+    if ((state_ != kConnected && state_ != kDisconnecting) || !inOwnerLoop() || targetLoop == getLoop())
+    {
+        return false;
+    }
+    LOG_DEBUG("TcpConnection::migrateTo [%s] fd=%d loop %p => %p\n", name_.c_str(), channel_->fd(), getLoop(), targetLoop);
+    {
+        // 和 runInOwnerLoop 互斥 之后发起的操作都排在 ownerFunctors_ 里已有的操作后面
+        std::unique_lock<std::mutex> lock(migrateMutex_);
+        migrating_.store(true, std::memory_order_release);
+    }
+    channel_->moveToLoop(targetLoop, std::bind(&TcpConnection::migrated, shared_from_this(), targetLoop, cb));
+    return true;
+}
+
+// 在新 loop 线程中执行 channel 已经注册到新 loop 上
+void TcpConnection::migrated(EventLoop *targetLoop, const MigratedCallback &cb)
+{
+    {
+        std::unique_lock<std::mutex> lock(migrateMutex_);
+        loop_.store(targetLoop, std::memory_order_release);
+        migrating_.store(false, std::memory_order_release);
+    }
+    doOwnerFunctors();
+    if (cb)
+    {
+        cb(shared_from_this());
+    }
+}
+
+bool TcpConnection::inOwnerLoop() const
+{
+    return !migrating_.load(std::memory_order_acquire) && getLoop()->isInLoopThread();
+}
+
+// 所有跨线程的操作排在同一个队列里 执行顺序就是发起顺序 不会因为迁移而乱序
+void TcpConnection::runInOwnerLoop(std::function<void()> cb)
+{
+    std::unique_lock<std::mutex> lock(migrateMutex_);
+    ownerFunctors_.push_back(std::move(cb));
+    // 迁移中不登记 由 migrated 在新 loop 中执行
+    if (!migrating_.load(std::memory_order_relaxed) && !ownerFunctorsQueued_)
+    {
+        ownerFunctorsQueued_ = true;
+        getLoop()->queueInLoop(std::bind(&TcpConnection::doOwnerFunctors, shared_from_this()));
+    }
+}
+
+void TcpConnection::doOwnerFunctors()
+{
+    std::unique_lock<std::mutex> lock(migrateMutex_);
+    ownerFunctorsQueued_ = false;
+    // 只执行进来时已有的操作 之后放进来的由它们登记的 doOwnerFunctors 执行 别的线程一直发送时 loop 也能回到 poll
+    // 每次取一个 执行的操作可能发起迁移(比如回调里调用 migrateTo) 剩下的留给新 loop
+    size_t n = ownerFunctors_.size();
+    while (n-- > 0 && inOwnerLoop())
+    {
+        std::function<void()> functor(std::move(ownerFunctors_.front()));
+        ownerFunctors_.pop_front();
+        lock.unlock();
+        functor();
+        lock.lock();
+    }
+}
+
+// poller => channel::closeCallback => TcpConnection::handleClose
+void TcpConnection::handleClose()
+{
+    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d\n", channel_->fd(), (int)state_);
+    setState(kDisconnected);
+    channel_->disableAll();
+
+    TcpConnectionPtr connPtr(shared_from_this());
+    if (connectionCallback_)
+    {
+        connectionCallback_(connPtr);    // 执行连接关闭的回调
+    }
+    if (closeCallback_)
+    {
+        closeCallback_(connPtr);         // 关闭连接的回调  执行的是TcpServer::removeConnection回调方法
+    }
+}
+
+void TcpConnection::handleError()
+{
+    // 零拷贝的完成通知放在 socket 的错误队列里 也以 EPOLLERR 报告
+    if (zeroCopyState_ != kZeroCopyOff)
+    {
+        handleZeroCopyCompletions();
+    }
+
+    int optval;
+    socklen_t optlen = sizeof optval;
+    int err = 0;
+    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        err = errno;
+    }
+    else
+    {
+        err = optval;
+    }
+    if (err == 0)
+    {
+        return;                  // 只有零拷贝的完成通知
+    }
+    LOG_ERROR_RATELIMITED(5, 1, "TcpConnection::handleError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
+}
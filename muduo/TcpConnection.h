@@ -0,0 +1,217 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "ChainBuffer.h"
+#include "Timestamp.h"
+
+class Channel;
+class EventLoop;
+class Socket;
+
+/**
+ * TcpServer => Acceptor => 有一个新用户连接 通过accept函数拿到connfd
+ * => TcpConnection 设置回调 => Channel => Poller => Channel的回调操作
+ *
+ * send 在 loop 线程中 发送缓冲为空时直接 write 写不完的部分才放进 outputBuffer_ 并关注写事件
+ * 发送缓冲积压超过 highWaterMark_ 时调用 highWaterMarkCallback_ 让上游暂停生产
+ *
+ * 打开写合并后 send 只追加到 outputBuffer_ 本轮循环结束时(EventLoop::runAfterIteration)每个连接写一次
+ * 一轮里产生的多个小响应合成一次系统调用 内核也能发出满的报文段 代价是响应推迟到本轮末尾
+ *
+ * sendFile 用 sendfile 把文件内容直接从页缓存发到 socket 不经过用户态缓冲 发送缓冲满了就关注写事件 等 EPOLLOUT 继续
+ * 发送顺序和调用顺序一致 排在文件前面的数据先写 文件没发完时再 send 的数据挂在这个文件后面(PendingSegment::trailer)
+ *
+ * sendZeroCopy 用 MSG_ZEROCOPY 发送大块数据 内核直接引用用户页 不拷贝到 socket 缓冲
+ * 数据块要一直持有到 socket 错误队列上的完成通知到达(EPOLLERR => handleError) 通知里的序号区间之前的块才释放
+ * 完成通知说内核还是拷贝了(SO_EE_CODE_ZEROCOPY_COPIED 比如 loopback) 这个连接以后退回普通 send
+ *
+ * send(ChainBuffer *) 把由多块拼成的响应整条排进发送队列 用 writev 写出 引用的块(比如缓存的正文)不拷贝
+ *
+ * migrateTo 把连接交给另一个 loop(Channel::moveToLoop) 交接期间两个 loop 都不处理这个连接
+ * 别的线程发起的操作都先放进连接自己的队列(ownerFunctors_) 由连接所在的 loop 按发起顺序执行
+ * 迁移期间队列暂停 交接完成后在新 loop 中接着执行 迁移前已经发起的操作仍然排在迁移期间发起的操作前面
+ **/
+class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
+{
+public:
+    // 小于这个大小时 固定的通知和页锁定开销超过拷贝本身 零拷贝不划算
+    static const size_t kDefaultZeroCopyThreshold = 10 * 1024;
+
+    TcpConnection(EventLoop *loop,
+                  const std::string &name,
+                  int sockfd,
+                  const InetAddress &localAddr,
+                  const InetAddress &peerAddr);
+    ~TcpConnection();
+
+    // 连接迁移后会变 跨线程使用时只能当作提示
+    EventLoop *getLoop() const { return loop_.load(std::memory_order_acquire); }
+    const std::string &name() const { return name_; }
+    const InetAddress &localAddress() const { return localAddr_; }
+    const InetAddress &peerAddress() const { return peerAddr_; }
+
+    bool connected() const { return state_ == kConnected; }
+    // 收到的字节数 任意线程都可以读 TcpServer::rebalance 据此挑选要迁移的连接
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
+
+    /**
+     * 在连接所在的 loop 线程中调用 把连接迁到 targetLoop 上 已经断开 正在迁移或者不在所在的线程中时返回 false
+     * 迁移完成后 getLoop() 返回 targetLoop 回调之后都在 targetLoop 线程中执行 然后在 targetLoop 线程中调用 cb
+     **/
+    bool migrateTo(EventLoop *targetLoop, const MigratedCallback &cb = MigratedCallback());
+
+    // 发送数据 任意线程都可以调用
+    void send(const std::string &buf);
+    void send(const char *data, size_t len);
+    /**
+     * 发送文件 fd 从 offset 开始的 len 字节 任意线程都可以调用
+     * fd 在调用时被 dup 调用返回后就可以关闭 发送完成前不要截断文件
+     **/
+    void sendFile(int fd, off_t offset, size_t len);
+    /**
+     * 零拷贝发送 block 任意线程都可以调用 block 在内核发送完成前一直被引用 内容不能再改
+     * 小于 zeroCopyThreshold 或者 socket 不支持 SO_ZEROCOPY 时和 send 一样拷贝发送
+     **/
+    void sendZeroCopy(const ChainBuffer::Block &block);
+    // 发送 buf 中的全部数据 任意线程都可以调用 返回后 buf 为空 引用的 Block 在发送完成前不能再改
+    void send(ChainBuffer *buf);
+    // 在 loop 线程中设置 默认 kDefaultZeroCopyThreshold
+    void setZeroCopyThreshold(size_t bytes) { zeroCopyThreshold_ = bytes; }
+    // 关闭连接 发送缓冲中的数据写完后才关闭写端
+    void shutdown();
+
+    // 只是 setsockopt 任意线程都可以调用
+    void setTcpNoDelay(bool on);
+    void setQuickAck(bool on);
+
+    // 在 loop 线程中设置
+    void setWriteCoalescing(bool on) { coalesceWrites_ = on; }
+    bool writeCoalescing() const { return coalesceWrites_; }
+
+    // 暂停/恢复读 配合高水位回调做背压
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
+    {
+        highWaterMarkCallback_ = cb;
+        highWaterMark_ = highWaterMark;
+    }
+    void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+
+    Buffer *inputBuffer() { return &inputBuffer_; }
+    Buffer *outputBuffer() { return &outputBuffer_; }
+
+    // 连接建立
+    void connectEstablished();
+    // 连接销毁
+    void connectDestroyed();
+
+private:
+    enum StateE
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected,
+        kDisconnecting
+    };
+    void setState(StateE state) { state_ = state; }
+
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void handleClose();
+    void handleError();
+
+    enum ZeroCopyState
+    {
+        kZeroCopyOff,            // 还没设置 SO_ZEROCOPY
+        kZeroCopyOn,
+        kZeroCopyFallback,       // 不支持或者内核一直在拷贝 退回普通 send
+    };
+
+    // 排队等待发送的文件(fd >= 0) 分片链(chain) 或者零拷贝数据块(block) 以及在它之后 send 的数据
+    struct PendingSegment
+    {
+        PendingSegment() : fd(-1), offset(0), remaining(0) {}
+
+        int fd;
+        std::shared_ptr<ChainBuffer> chain;
+        ChainBuffer::Block block;
+        off_t offset;            // 文件偏移 或者 block 内已发送的字节数
+        size_t remaining;
+        Buffer trailer;
+    };
+
+    void sendInLoop(const char *data, size_t len);
+    void sendFileInLoop(int fd, off_t offset, size_t len);
+    void sendZeroCopyInLoop(const ChainBuffer::Block &block);
+    void sendChainInLoop(const std::shared_ptr<ChainBuffer> &chain);
+    void queueSegment(PendingSegment &&segment);
+    ssize_t sendSegment(PendingSegment &segment);
+    void handleZeroCopyCompletions();
+    bool writePending();
+    void writeDrained();
+    void flushCoalesced();
+    void shutdownInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
+
+    // 连接正由本线程的 loop 处理 迁移中或者已经迁走时返回 false
+    bool inOwnerLoop() const;
+    // inOwnerLoop() 为 false 时调用 把操作放进 ownerFunctors_ 迁移中先攒着 由 migrated 执行
+    void runInOwnerLoop(std::function<void()> cb);
+    void doOwnerFunctors();
+    void migrated(EventLoop *targetLoop, const MigratedCallback &cb);
+
+    std::atomic<EventLoop *> loop_;  // 这里绝对不是baseLoop 因为TcpConnection都是在subLoop里面管理的 迁移后在新 loop 中更新
+    const std::string name_;
+    std::atomic_int state_;
+    bool reading_;
+    bool coalesceWrites_;
+    bool flushScheduled_;        // 已经登记了本轮末尾的 flushCoalesced
+
+    // 这里和Acceptor类似   Acceptor=》mainLoop    TcpConenction=》subLoop
+    std::unique_ptr<Socket> socket_;
+    std::unique_ptr<Channel> channel_;
+
+    const InetAddress localAddr_;
+    const InetAddress peerAddr_;
+
+    ConnectionCallback connectionCallback_;       // 有新连接时的回调
+    MessageCallback messageCallback_;             // 有读写消息时的回调
+    WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
+    HighWaterMarkCallback highWaterMarkCallback_;
+    CloseCallback closeCallback_;
+    size_t highWaterMark_;
+    size_t zeroCopyThreshold_;
+    ZeroCopyState zeroCopyState_;
+    uint32_t zeroCopySeq_;       // 下一次 MSG_ZEROCOPY 发送的序号 和内核的计数一致
+    std::deque<std::pair<uint32_t, ChainBuffer::Block>> zeroCopyInFlight_; // 序号 => 等完成通知的数据块
+
+    Buffer inputBuffer_;         // 接收数据的缓冲区
+    Buffer outputBuffer_;        // 发送数据的缓冲区
+    std::deque<PendingSegment> pendingSegments_; // 排在 outputBuffer_ 之后发送
+
+    std::atomic<uint64_t> bytesReceived_;        // 只有所在的 loop 线程写
+    std::atomic_bool migrating_;                 // 旧 loop 线程置位 新 loop 线程在迁移完成时清除
+    std::mutex migrateMutex_;                    // 保护 migrating_ 的清除 ownerFunctors_ 和 ownerFunctorsQueued_
+    std::deque<std::function<void()>> ownerFunctors_;   // 别的线程发起 等所在的 loop 执行的操作
+    bool ownerFunctorsQueued_;                   // 已经登记了 doOwnerFunctors
+};
@@ -0,0 +1,273 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "TcpProxy.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+TcpProxy::Direction::Direction(Channel *fromChannel, Channel *toChannel)
+    : from(fromChannel)
+    , to(toChannel)
+    , pending(0)
+    , eof(false)
+    , shutdown(false)
+    , forwarded(0)
+{
+    pipeFds[0] = pipeFds[1] = -1;
+}
+
+TcpProxy::Direction::~Direction()
+{
+    if (pipeFds[0] >= 0)
+    {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+    }
+}
+
+TcpProxy::TcpProxy(EventLoop *loop, const std::string &name, int downstreamFd, int upstreamFd, Mode mode)
+    : loop_(loop)
+    , name_(name)
+    , mode_(mode)
+    , closed_(false)
+    , downstream_(downstreamFd)
+    , upstream_(upstreamFd)
+    , downstreamChannel_(loop, downstreamFd)
+    , upstreamChannel_(loop, upstreamFd)
+    , toUpstream_(&downstreamChannel_, &upstreamChannel_)
+    , toDownstream_(&upstreamChannel_, &downstreamChannel_)
+{
+    if (mode_ == kSplice)
+    {
+        if (::pipe2(toUpstream_.pipeFds, O_NONBLOCK | O_CLOEXEC) < 0
+            || ::pipe2(toDownstream_.pipeFds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_FATAL("%s:%s:%d TcpProxy pipe2 err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+    }
+
+    // 一个 channel 可读是一个方向的源端 可写是另一个方向的目的端
+    downstreamChannel_.setReadCallback(std::bind(&TcpProxy::handleRead, this, &toUpstream_));
+    downstreamChannel_.setWriteCallback(std::bind(&TcpProxy::handleWrite, this, &toDownstream_));
+    downstreamChannel_.setCloseCallback(std::bind(&TcpProxy::handleClose, this));
+    downstreamChannel_.setErrorCallback(std::bind(&TcpProxy::handleError, this, &downstreamChannel_));
+    upstreamChannel_.setReadCallback(std::bind(&TcpProxy::handleRead, this, &toDownstream_));
+    upstreamChannel_.setWriteCallback(std::bind(&TcpProxy::handleWrite, this, &toUpstream_));
+    upstreamChannel_.setCloseCallback(std::bind(&TcpProxy::handleClose, this));
+    upstreamChannel_.setErrorCallback(std::bind(&TcpProxy::handleError, this, &upstreamChannel_));
+}
+
+TcpProxy::~TcpProxy()
+{
+    LOG_DEBUG("TcpProxy::dtor[%s] up:%lu down:%lu\n", name_.c_str(),
+              (unsigned long)toUpstream_.forwarded, (unsigned long)toDownstream_.forwarded);
+}
+
+void TcpProxy::start()
+{
+    loop_->runInLoop(std::bind(&TcpProxy::startInLoop, shared_from_this()));
+}
+
+void TcpProxy::startInLoop()
+{
+    downstreamChannel_.tie(shared_from_this());
+    upstreamChannel_.tie(shared_from_this());
+    downstreamChannel_.enableReading();
+    upstreamChannel_.enableReading();
+}
+
+// 源端可读 读进 pipe/Buffer 再尽量写到目的端
+void TcpProxy::handleRead(Direction *dir)
+{
+    if (closed_)
+    {
+        return;
+    }
+    if (fill(dir) && drain(dir))
+    {
+        update(dir);
+    }
+}
+
+// 目的端可写 把积压的数据写出去
+void TcpProxy::handleWrite(Direction *dir)
+{
+    if (closed_)
+    {
+        return;
+    }
+    if (drain(dir))
+    {
+        update(dir);
+    }
+}
+
+// 从源端读一次 出错时关闭并返回 false
+bool TcpProxy::fill(Direction *dir)
+{
+    int fd = dir->from->fd();
+    ssize_t n;
+    int savedErrno = 0;
+    if (mode_ == kSplice)
+    {
+        n = ::splice(fd, nullptr, dir->pipeFds[1], nullptr, kPipeSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        savedErrno = errno;
+    }
+    else
+    {
+        n = dir->buffer.readFd(fd, &savedErrno);
+    }
+
+    if (n > 0)
+    {
+        dir->pending += n;
+    }
+    else if (n == 0)
+    {
+        dir->eof = true;
+    }
+    else if (savedErrno != EAGAIN && savedErrno != EINTR)
+    {
+        LOG_ERROR_RATELIMITED(5, 1, "TcpProxy::fill [%s] fd=%d errno:%d\n", name_.c_str(), fd, savedErrno);
+        handleClose();
+        return false;
+    }
+    return true;
+}
+
+// 把积压的数据写到目的端 直到写完或者目的端的发送缓冲区满 出错时关闭并返回 false
+bool TcpProxy::drain(Direction *dir)
+{
+    int fd = dir->to->fd();
+    while (dir->pending > 0)
+    {
+        ssize_t n;
+        int savedErrno = 0;
+        if (mode_ == kSplice)
+        {
+            n = ::splice(dir->pipeFds[0], nullptr, fd, nullptr, dir->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            savedErrno = errno;
+        }
+        else
+        {
+            n = dir->buffer.writeFd(fd, &savedErrno);
+            if (n > 0)
+            {
+                dir->buffer.retrieve(n);
+            }
+        }
+
+        if (n > 0)
+        {
+            dir->pending -= n;
+            dir->forwarded += n;
+            continue;
+        }
+        if (n < 0 && savedErrno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && savedErrno != EAGAIN)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "TcpProxy::drain [%s] fd=%d errno:%d\n", name_.c_str(), fd, savedErrno);
+            handleClose();
+            return false;
+        }
+        break;                   // EAGAIN 目的端写不动了
+    }
+    return true;
+}
+
+/**
+ * 根据这个方向的积压调整两端关注的事件
+ * 有积压: 关注目的端可写 停止读源端 (背压)
+ * 没积压: 不再关注目的端可写 源端没到 EOF 就继续读 到了 EOF 就把 EOF 传给目的端
+ **/
+void TcpProxy::update(Direction *dir)
+{
+    if (dir->pending > 0)
+    {
+        if (!dir->to->isWriting())
+        {
+            dir->to->enableWriting();
+        }
+        if (dir->from->isReading())
+        {
+            dir->from->disableReading();
+        }
+        return;
+    }
+
+    if (dir->to->isWriting())
+    {
+        dir->to->disableWriting();
+    }
+    if (!dir->eof)
+    {
+        if (!dir->from->isReading())
+        {
+            dir->from->enableReading();
+        }
+        return;
+    }
+
+    // 到了 EOF LT 模式下源端会一直可读 不再关注
+    if (dir->from->isReading())
+    {
+        dir->from->disableReading();
+    }
+    if (!dir->shutdown)
+    {
+        dir->shutdown = true;
+        Socket &target = dir == &toUpstream_ ? upstream_ : downstream_;
+        target.shutdownWrite();
+    }
+    if (toUpstream_.shutdown && toDownstream_.shutdown)
+    {
+        handleClose();
+    }
+}
+
+void TcpProxy::handleClose()
+{
+    if (closed_)
+    {
+        return;
+    }
+    closed_ = true;
+    downstreamChannel_.disableAll();
+    upstreamChannel_.disableAll();
+
+    TcpProxyPtr guard(shared_from_this());
+    if (closeCallback_)
+    {
+        closeCallback_(guard);
+    }
+    // 这一轮 poll 返回的事件里可能还有另一端的 channel 推迟到下一轮再从 poller 中删除
+    loop_->queueInLoop(std::bind(&TcpProxy::destroyed, guard));
+}
+
+void TcpProxy::handleError(Channel *channel)
+{
+    int optval;
+    socklen_t optlen = sizeof optval;
+    int err = 0;
+    if (::getsockopt(channel->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        err = errno;
+    }
+    else
+    {
+        err = optval;
+    }
+    LOG_ERROR_RATELIMITED(5, 1, "TcpProxy::handleError [%s] fd=%d SO_ERROR:%d\n", name_.c_str(), channel->fd(), err);
+    handleClose();
+}
+
+void TcpProxy::destroyed()
+{
+    downstreamChannel_.remove();
+    upstreamChannel_.remove();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "Channel.h"
+#include "Socket.h"
+
+class EventLoop;
+
+/**
+ * 在两个已经建立的 TCP socket 之间双向转发字节 四层代理的基本单元
+ * kSplice 模式每个方向一个 pipe 用 splice 把数据从源 socket 移进 pipe 再从 pipe 移到目的 socket 不经过用户态
+ * kCopy 模式用 Buffer 中转 read 再 write
+ *
+ * 一个方向积压的数据没能全部写到目的端时 停止读这个方向的源端 等目的端可写写完再读
+ * 慢的一端因此会让快的一端的 TCP 接收窗口收紧 代理自己每个方向最多积压一个 pipe 的数据
+ * 源端读到 EOF 并且积压的数据写完后 shutdown 目的端的写 两个方向都结束或者任一端出错时关闭
+ * 上游的 fd 可以是还在非阻塞 connect 中的 socket 连上之前的写返回 EAGAIN 等可写事件再发
+ **/
+class TcpProxy : noncopyable, public std::enable_shared_from_this<TcpProxy>
+{
+public:
+    using TcpProxyPtr = std::shared_ptr<TcpProxy>;
+    using CloseCallback = std::function<void(const TcpProxyPtr &)>;
+
+    enum Mode
+    {
+        kSplice,
+        kCopy,
+    };
+
+    static const size_t kPipeSize = 64 * 1024;   // 每次从源端最多读的字节数 和 pipe 的默认容量一致
+
+    // 接管两个非阻塞 socket 的所有权 关闭时一起关掉
+    TcpProxy(EventLoop *loop, const std::string &name, int downstreamFd, int upstreamFd, Mode mode = kSplice);
+    ~TcpProxy();
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+
+    // 关闭后在 loop 线程中调用 上层在这里把 TcpProxy 从自己的表中删掉
+    void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+
+    // 开始转发 任意线程都可以调用
+    void start();
+
+    uint64_t bytesToUpstream() const { return toUpstream_.forwarded; }
+    uint64_t bytesToDownstream() const { return toDownstream_.forwarded; }
+
+private:
+    // 一个方向 from 读到的数据写到 to
+    struct Direction
+    {
+        Direction(Channel *fromChannel, Channel *toChannel);
+        ~Direction();
+
+        Channel *from;
+        Channel *to;
+        int pipeFds[2];          // kSplice 模式 [0] 读端 [1] 写端
+        Buffer buffer;           // kCopy 模式
+        size_t pending;          // 已经读进来 还没写出去的字节数
+        bool eof;                // 源端已经读到 EOF
+        bool shutdown;           // 已经 shutdown 目的端的写
+        uint64_t forwarded;
+    };
+
+    void startInLoop();
+    void handleRead(Direction *dir);
+    void handleWrite(Direction *dir);
+    void handleClose();
+    void handleError(Channel *channel);
+    void destroyed();
+
+    bool fill(Direction *dir);
+    bool drain(Direction *dir);
+    void update(Direction *dir);
+
+    EventLoop *loop_;
+    const std::string name_;
+    const Mode mode_;
+    bool closed_;
+
+    Socket downstream_;
+    Socket upstream_;
+    Channel downstreamChannel_;
+    Channel upstreamChannel_;
+    Direction toUpstream_;       // downstream => upstream
+    Direction toDownstream_;     // upstream => downstream
+
+    CloseCallback closeCallback_;
+};
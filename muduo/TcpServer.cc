@@ -1,6 +1,487 @@
+#include <algorithm>
 #include <functional>
+#include <future>
 #include <string.h>
 
 #include "TcpServer.h"
 #include "Logger.h"
-// #include "TcpConnection.h"
\ No newline at end of file
+#include "TcpConnection.h"
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+// 在 loop 线程中执行 cb 并等它完成 只用于 start 和析构这种不在热路径上的地方
+static void runInLoopAndWait(EventLoop *loop, const EventLoop::Functor &cb)
+{
+    if (loop->isInLoopThread())
+    {
+        cb();
+        return;
+    }
+    std::promise<void> done;
+    loop->runInLoop([&cb, &done]() {
+        cb();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+static void defaultConnectionCallback(const TcpConnectionPtr &conn)
+{
+    LOG_DEBUG("%s -> %s is %s\n", conn->localAddress().toIpPort().c_str(), conn->peerAddress().toIpPort().c_str(),
+              conn->connected() ? "UP" : "DOWN");
+}
+
+static void defaultMessageCallback(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+                     const InetAddress &listenAddr,
+                     const std::string &nameArg,
+                     Option option)
+    : loop_(CheckLoopNotNull(loop))
+    , ipPort_(listenAddr.toIpPort())
+    , name_(nameArg)
+    , listenAddr_(listenAddr)
+    , option_(option)
+    , acceptor_(option == kReusePortPerLoop ? nullptr : new Acceptor(loop, listenAddr, option == kReusePort))
+    , acceptBatch_(Acceptor::kDefaultAcceptBatch)
+    , cpuSteering_(false)
+    , threadPool_(new EventLoopThreadPool(loop, name_))
+    , connectionCallback_(defaultConnectionCallback)
+    , messageCallback_(defaultMessageCallback)
+    , started_(0)
+    , nextConnId_(1)
+    , nextMigrationTarget_(0)
+    , waitingResize_(-1)
+{
+    if (acceptor_)
+    {
+        // 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生，执行handleRead()调用TcpServer::newConnection回调
+        acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
+                                                      std::placeholders::_1, std::placeholders::_2));
+        acceptor_->setAcceptBatchEndCallback(std::bind(&TcpServer::handOffConnections, this));
+    }
+}
+
+TcpServer::~TcpServer()
+{
+    for (auto &item : connections_)
+    {
+        // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
+        TcpConnectionPtr conn(item.second);
+        item.second.reset();
+
+        // 销毁连接
+        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    }
+
+    // 各 loop 的 Acceptor 和连接表只能在自己的 loop 中销毁 等它完成 之后不会再有回调进入 TcpServer
+    for (auto &local : loopAcceptors_)
+    {
+        LoopAcceptor *l = local.get();
+        runInLoopAndWait(l->loop, [l]() {
+            l->acceptor.reset();
+            for (auto &item : l->connections)
+            {
+                item.second->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, item.second));
+            }
+            l->connections.clear();
+        });
+    }
+}
+
+// 设置底层subloop的个数
+void TcpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+// 开启服务器监听
+void TcpServer::start()
+{
+    if (started_++ == 0)         // 防止一个TcpServer对象被start多次
+    {
+        threadPool_->start(threadInitCallback_); // 启动底层的loop线程池
+        {
+            std::unique_lock<std::mutex> lock(migrationMutex_);
+            migrationTargets_ = threadPool_->getAllLoops();
+        }
+        if (option_ == kReusePortPerLoop)
+        {
+            startLoopAcceptors();
+        }
+        else
+        {
+            acceptor_->setAcceptBatch(acceptBatch_);
+            applyListenOptions(acceptor_.get());
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+    }
+}
+
+void TcpServer::resize(int numThreads)
+{
+    if (started_ == 0)
+    {
+        setThreadNum(numThreads);
+        return;
+    }
+    if (option_ == kReusePortPerLoop)
+    {
+        LOG_ERROR("TcpServer::resize [%s] not supported with kReusePortPerLoop\n", name_.c_str());
+        return;
+    }
+    loop_->runInLoop(std::bind(&TcpServer::resizeInLoop, this, numThreads));
+}
+
+void TcpServer::resizeInLoop(int numThreads)
+{
+    if (numThreads < 0)
+    {
+        numThreads = 0;
+    }
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    if (numThreads >= threadPool_->numThreads())
+    {
+        threadPool_->resize(numThreads);
+        std::unique_lock<std::mutex> lock(migrationMutex_);
+        migrationTargets_ = threadPool_->getAllLoops();
+        waitingResize_ = -1;     // 还在等迁移的缩容作废
+        return;
+    }
+
+    // 线程池从尾部摘除 留下前 numThreads 个 一个都不剩时 getNextLoop 返回 mainLoop
+    std::vector<EventLoop *> targets(loops.begin(), loops.begin() + numThreads);
+    if (targets.empty())
+    {
+        targets.push_back(loop_);
+    }
+    {
+        // 先不再接受迁入 还有迁入途中的连接时等它们到达(connectionMigrated)再来一次 否则它们会落在已经退出的 loop 上
+        std::unique_lock<std::mutex> lock(migrationMutex_);
+        migrationTargets_ = targets;
+        waitingResize_ = -1;
+        for (auto it = loops.begin() + numThreads; it != loops.end(); ++it)
+        {
+            if (migrationsInFlight_.count(*it) > 0)
+            {
+                waitingResize_ = numThreads;
+                return;
+            }
+        }
+    }
+    std::shared_ptr<std::vector<TcpConnectionPtr>> conns(new std::vector<TcpConnectionPtr>);
+    conns->reserve(connections_.size());
+    for (const auto &item : connections_)
+    {
+        conns->push_back(item.second);
+    }
+    threadPool_->resize(numThreads, std::bind(&TcpServer::drainConnections, this, conns, std::placeholders::_1));
+}
+
+bool TcpServer::rebalance(double imbalanceRatio)
+{
+    if (option_ == kReusePortPerLoop)
+    {
+        return false;
+    }
+
+    // 各连接自上次调用以来收到的字节数 已经关闭的连接不再记录
+    std::shared_ptr<RecentTraffic> recent(new RecentTraffic);
+    std::unordered_map<std::string, uint64_t> bytesReceived;
+    recent->reserve(connections_.size());
+    for (const auto &item : connections_)
+    {
+        uint64_t bytes = item.second->bytesReceived();
+        auto last = lastBytesReceived_.find(item.first);
+        recent->emplace_back(bytes - (last == lastBytesReceived_.end() ? 0 : last->second), item.second);
+        bytesReceived[item.first] = bytes;
+    }
+    lastBytesReceived_.swap(bytesReceived);
+
+    return threadPool_->rebalance(std::bind(&TcpServer::migrateBusiestConnections, this, recent,
+                                            std::placeholders::_1, std::placeholders::_2),
+                                  imbalanceRatio);
+}
+
+// 在最忙的 from 线程中执行 从最活跃的连接开始迁到 to 累计不超过 from 最近流量的一半
+// 单个连接就超过一半的不迁 迁过去只是换了一个 loop 忙
+void TcpServer::migrateBusiestConnections(const std::shared_ptr<RecentTraffic> &recent, EventLoop *from, EventLoop *to)
+{
+    RecentTraffic candidates;
+    uint64_t total = 0;
+    for (const auto &item : *recent)
+    {
+        // 只有 from 线程会把连接从 from 迁走 这里读到的 loop 是准确的
+        if (item.first > 0 && item.second->getLoop() == from)
+        {
+            candidates.push_back(item);
+            total += item.first;
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const RecentTraffic::value_type &a, const RecentTraffic::value_type &b) { return a.first > b.first; });
+
+    uint64_t moved = 0;
+    int count = 0;
+    for (const auto &item : candidates)
+    {
+        if (moved + item.first <= total / 2 && migrateConnection(item.second, to))
+        {
+            moved += item.first;
+            ++count;
+        }
+    }
+    LOG_INFO("TcpServer rebalance: migrated %d connections (%lu of %lu bytes) from loop %p to loop %p\n",
+             count, (unsigned long)moved, (unsigned long)total, from, to);
+}
+
+// 在被摘除的 loop 线程中执行 把这个 loop 上的连接轮流迁到可以迁入的 loop 上
+// 只有这个线程会把连接从 loop 迁走 这里读到的 loop 是准确的 已经断开的连接由 mainLoop 发来的 connectDestroyed 销毁
+void TcpServer::drainConnections(const std::shared_ptr<std::vector<TcpConnectionPtr>> &conns, EventLoop *loop)
+{
+    int moved = 0;
+    for (const TcpConnectionPtr &conn : *conns)
+    {
+        if (conn->getLoop() == loop && migrateConnection(conn, nullptr))
+        {
+            ++moved;
+        }
+    }
+    LOG_INFO("TcpServer resize: migrated %d connections off loop %p\n", moved, loop);
+}
+
+/**
+ * 在 conn 所在的 loop 线程中调用 只迁往 migrationTargets_ 中的 loop to 为空时轮流选一个
+ * 检查目标和登记迁移在同一个临界区里 缩容摘掉目标 loop 之后不会再有迁入 已经登记的迁移完成前不会摘除
+ **/
+bool TcpServer::migrateConnection(const TcpConnectionPtr &conn, EventLoop *to)
+{
+    {
+        std::unique_lock<std::mutex> lock(migrationMutex_);
+        if (to == nullptr)
+        {
+            to = migrationTargets_[nextMigrationTarget_++ % migrationTargets_.size()];
+        }
+        else if (std::find(migrationTargets_.begin(), migrationTargets_.end(), to) == migrationTargets_.end())
+        {
+            return false;
+        }
+        ++migrationsInFlight_[to];
+    }
+    if (conn->migrateTo(to, std::bind(&TcpServer::connectionMigrated, this, to)))
+    {
+        return true;
+    }
+    connectionMigrated(to);
+    return false;
+}
+
+// 迁移完成时在目标 loop 线程中执行 有缩容在等时回到 mainLoop 再检查一次
+void TcpServer::connectionMigrated(EventLoop *to)
+{
+    std::unique_lock<std::mutex> lock(migrationMutex_);
+    auto it = migrationsInFlight_.find(to);
+    if (--it->second == 0)
+    {
+        migrationsInFlight_.erase(it);
+        if (waitingResize_ >= 0)
+        {
+            loop_->queueInLoop(std::bind(&TcpServer::resizeInLoop, this, waitingResize_));
+            waitingResize_ = -1;
+        }
+    }
+}
+
+void TcpServer::startLoopAcceptors()
+{
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        std::unique_ptr<LoopAcceptor> local(new LoopAcceptor);
+        local->loop = loops[i];
+        local->index = static_cast<int>(i);
+        local->acceptor.reset(new Acceptor(loops[i], listenAddr_, true));
+        local->acceptor->setAcceptBatch(acceptBatch_);
+        applyListenOptions(local->acceptor.get());
+        local->acceptor->setNewConnectionCallback(std::bind(&TcpServer::newLoopConnection, this, local.get(),
+                                                            std::placeholders::_1, std::placeholders::_2));
+        local->nextConnId = 1;
+        loopAcceptors_.push_back(std::move(local));
+    }
+
+    // socket 在 listen 时按顺序加入 SO_REUSEPORT 组 逐个等待 保证组内下标就是 loop 的下标
+    for (auto &local : loopAcceptors_)
+    {
+        runInLoopAndWait(local->loop, std::bind(&Acceptor::listen, local->acceptor.get()));
+    }
+    if (cpuSteering_)
+    {
+        loopAcceptors_.front()->acceptor->setReusePortCpuSteering(static_cast<int>(loopAcceptors_.size()));
+    }
+}
+
+void TcpServer::applyListenOptions(Acceptor *acceptor)
+{
+    Socket &socket = acceptor->socket();
+    acceptor->setBacklog(options_.backlog);
+    if (options_.deferAcceptSeconds > 0)
+    {
+        socket.setDeferAccept(options_.deferAcceptSeconds);
+    }
+    if (options_.fastOpenQueueLength > 0)
+    {
+        socket.setFastOpen(options_.fastOpenQueueLength);
+    }
+    if (options_.recvBufferSize > 0)
+    {
+        socket.setRecvBufferSize(options_.recvBufferSize);
+    }
+    if (options_.sendBufferSize > 0)
+    {
+        socket.setSendBufferSize(options_.sendBufferSize);
+    }
+    if (options_.notSentLowat > 0)
+    {
+        socket.setNotSentLowat(options_.notSentLowat);
+    }
+    if (options_.maxPacingRate > 0)
+    {
+        socket.setMaxPacingRate(options_.maxPacingRate);
+    }
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, const std::string &connName, int sockfd, const InetAddress &peerAddr)
+{
+    LOG_DEBUG("TcpServer::newConnection [%s] - new connection [%s] from %s\n",
+              name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+
+    // 通过sockfd获取其绑定的本机的ip地址和端口信息
+    sockaddr_in local;
+    ::memset(&local, 0, sizeof local);
+    socklen_t addrlen = sizeof local;
+    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr");
+    }
+    InetAddress localAddr(local);
+
+    // 根据连接成功的sockfd，创建TcpConnection连接对象
+    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
+    // 下面的回调都是用户设置给TcpServer=>TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (options_.tcpNoDelay)
+    {
+        conn->setTcpNoDelay(true);
+    }
+    if (options_.quickAck)
+    {
+        conn->setQuickAck(true);
+    }
+    conn->setWriteCoalescing(options_.writeCoalescing);
+    return conn;
+}
+
+// kReusePortPerLoop 在 accept 它的 loop 中执行 直接在本 loop 上建立连接
+void TcpServer::newLoopConnection(LoopAcceptor *local, int sockfd, const InetAddress &peerAddr)
+{
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, "-%s#%d#%d", ipPort_.c_str(), local->index, local->nextConnId);
+    ++local->nextConnId;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn = createConnection(local->loop, connName, sockfd, peerAddr);
+    local->connections[connName] = conn;
+    conn->setCloseCallback(std::bind(&TcpServer::removeLoopConnection, this, local, std::placeholders::_1));
+    conn->connectEstablished();
+}
+
+// 连接关闭时在它自己的 loop 中执行
+void TcpServer::removeLoopConnection(LoopAcceptor *local, const TcpConnectionPtr &conn)
+{
+    local->connections.erase(conn->name());
+    local->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+// 有一个新的客户端的连接，acceptor会执行这个回调操作，负责将mainLoop接收到的请求连接(acceptChannel_会有读事件发生)通过回调轮询分发给subLoop去处理
+void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+{
+    // 轮询算法，选择一个subLoop，来管理connfd对应的channel
+    EventLoop *ioLoop = threadPool_->getNextLoop();
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn = createConnection(ioLoop, connName, sockfd, peerAddr);
+    connections_[connName] = conn;
+
+    // 设置了如何关闭连接的回调   conn->shutDown()
+    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
+
+    // 先攒着 Acceptor 处理完这一批后在 handOffConnections 中统一交给 subLoop 执行 connectEstablished
+    auto it = pendingConnections_.begin();
+    while (it != pendingConnections_.end() && it->first != ioLoop)
+    {
+        ++it;
+    }
+    if (it == pendingConnections_.end())
+    {
+        pendingConnections_.emplace_back(ioLoop, std::vector<TcpConnectionPtr>());
+        it = pendingConnections_.end() - 1;
+    }
+    it->second.push_back(std::move(conn));
+}
+
+void TcpServer::handOffConnections()
+{
+    for (auto &pending : pendingConnections_)
+    {
+        if (pending.second.empty())
+        {
+            continue;
+        }
+        EventLoop *ioLoop = pending.first;
+        if (pending.second.size() == 1)
+        {
+            ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, pending.second.front()));
+        }
+        else
+        {
+            std::shared_ptr<std::vector<TcpConnectionPtr>> batch(new std::vector<TcpConnectionPtr>());
+            batch->swap(pending.second);
+            ioLoop->runInLoop([batch]() {
+                for (const TcpConnectionPtr &conn : *batch)
+                {
+                    conn->connectEstablished();
+                }
+            });
+        }
+        pending.second.clear();
+    }
+}
+
+void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+{
+    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+}
+
+void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+{
+    LOG_DEBUG("TcpServer::removeConnectionInLoop [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
+
+    connections_.erase(conn->name());
+    EventLoop *ioLoop = conn->getLoop();
+    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
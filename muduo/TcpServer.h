@@ -1,4 +1,4 @@
-#pragma one
+#pragma once
 
 /**
  * 用户使用muduo编写服务器程序
@@ -8,19 +8,183 @@
 #include <string>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "EventLoop.h"
-// #include "Acceptor.h"
+#include "Acceptor.h"
 #include "InetAddress.h"
 #include "noncopyable.h"
-// #include "EventLoopThreadPool.h"
-// #include "Callbacks.h"
-// #include "TcpConnection.h"
-// #include "Buffer.h"
+#include "EventLoopThreadPool.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
 
-// 对外的服务器编程使用的类
-class TcpServer
+/**
+ * 对外的服务器编程使用的类
+ * mainLoop 里的 Acceptor 接受新连接 按 EventLoopThreadPool::getNextLoop 轮询交给 subLoop
+ * 一次可读事件 accept 到的连接按 subLoop 分组 每个 subLoop 只收到一个回调(最多一次 wakeup)
+ * 连接的读写都在 subLoop 中进行 连接的登记和删除在 mainLoop 中进行
+ *
+ * kReusePortPerLoop 模式下每个 loop 各自 bind 一个 SO_REUSEPORT 的 listen socket 由内核在它们之间分配新连接
+ * 连接在哪个 loop 上 accept 就在哪个 loop 上处理 没有跨线程的交接 连接表也按 loop 分开 只在本 loop 中访问
+ * 这个模式下不支持 resize
+ **/
+class TcpServer : noncopyable
 {
-    
-};
\ No newline at end of file
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    /**
+     * listen socket 和新连接的 TCP 选项 start() 之前通过 setOptions 设置 0/false 表示不设置 用系统默认值
+     * deferAcceptSeconds 和 fastOpenQueueLength 能省掉新连接的一个往返 也不会为还没发数据的连接唤醒 loop
+     * 缓冲区大小 notSentLowat maxPacingRate 设置在 listen socket 上 由 accept 出来的连接继承
+     **/
+    struct Options
+    {
+        Options()
+            : backlog(Socket::kDefaultBacklog)
+            , deferAcceptSeconds(0)
+            , fastOpenQueueLength(0)
+            , tcpNoDelay(false)
+            , quickAck(false)
+            , recvBufferSize(0)
+            , sendBufferSize(0)
+            , notSentLowat(0)
+            , maxPacingRate(0)
+            , writeCoalescing(false)
+        {}
+
+        int backlog;
+        int deferAcceptSeconds;  // TCP_DEFER_ACCEPT
+        int fastOpenQueueLength; // TCP_FASTOPEN
+        bool tcpNoDelay;         // 每个连接设置
+        bool quickAck;           // 每个连接建立时设置一次
+        int recvBufferSize;      // SO_RCVBUF
+        int sendBufferSize;      // SO_SNDBUF
+        int notSentLowat;        // TCP_NOTSENT_LOWAT
+        uint64_t maxPacingRate;  // SO_MAX_PACING_RATE 字节每秒
+        bool writeCoalescing;    // 见 TcpConnection::setWriteCoalescing
+    };
+
+    enum Option
+    {
+        kNoReusePort,
+        kReusePort,
+        kReusePortPerLoop,       // 每个 loop 一个 SO_REUSEPORT 的 Acceptor
+    };
+
+    TcpServer(EventLoop *loop,
+              const InetAddress &listenAddr,
+              const std::string &nameArg,
+              Option option = kNoReusePort);
+    ~TcpServer();
+
+    const std::string &ipPort() const { return ipPort_; }
+    const std::string &name() const { return name_; }
+    EventLoop *getLoop() const { return loop_; }
+
+    void setThreadInitcallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+    // 设置底层subloop的个数 start() 之前调用
+    void setThreadNum(int numThreads);
+    // 每次可读事件最多 accept 的连接数 start() 之前调用
+    void setAcceptBatch(int batch) { acceptBatch_ = batch; }
+    /**
+     * kReusePortPerLoop 模式下 按处理该连接数据包的 CPU 选择 loop(SO_ATTACH_REUSEPORT_CBPF) start() 之前调用
+     * 第 i 个 loop 对应 CPU i % loop 数 需要在 ThreadInitCallback 中把 loop 线程绑到对应的 CPU 上才有意义
+     **/
+    void setReusePortCpuSteering(bool on) { cpuSteering_ = on; }
+    void setOptions(const Options &options) { options_ = options; }
+    const Options &options() const { return options_; }
+
+    /**
+     * start() 之后调整 subLoop 数量 任意线程都可以调用 在 mainLoop 中执行
+     * 缩容时被摘除的 loop 上的连接轮流迁到剩下的 loop 上(一个都不剩时迁到 mainLoop) 连接不会断开
+     * 被摘除的 loop 马上不再接受迁入 还在迁入途中的连接(比如 rebalance 发起的)到达之后才开始摘除
+     **/
+    void resize(int numThreads);
+    // 当前所有的 subLoop 在 mainLoop 中调用 线程池不再对外暴露 缩容必须经过 resize 迁走连接
+    std::vector<EventLoop *> getAllLoops() { return threadPool_->getAllLoops(); }
+
+    // 开启服务器监听 可以多次调用
+    void start();
+
+    /**
+     * start() 之后在 mainLoop 中周期性调用(比如每隔几秒一次) 判断方法见 EventLoopThreadPool::rebalance
+     * subLoop 之间负载不均时 把最忙的 loop 上最近收数据最多的一批连接迁到最闲的 loop 上 大约移走它一半的流量
+     * 最近的流量是两次调用之间收到的字节数 kReusePortPerLoop 模式下不迁移 返回是否触发了迁移
+     **/
+    bool rebalance(double imbalanceRatio = 2.0);
+
+private:
+    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using RecentTraffic = std::vector<std::pair<uint64_t, TcpConnectionPtr>>;   // 最近收到的字节数 连接
+
+    // kReusePortPerLoop 模式下每个 loop 一份 只在 loop 线程中访问
+    struct LoopAcceptor
+    {
+        EventLoop *loop;
+        int index;
+        std::unique_ptr<Acceptor> acceptor;
+        ConnectionMap connections;
+        int nextConnId;
+    };
+
+    void resizeInLoop(int numThreads);
+    void migrateBusiestConnections(const std::shared_ptr<RecentTraffic> &recent, EventLoop *from, EventLoop *to);
+    void drainConnections(const std::shared_ptr<std::vector<TcpConnectionPtr>> &conns, EventLoop *loop);
+    bool migrateConnection(const TcpConnectionPtr &conn, EventLoop *to);
+    void connectionMigrated(EventLoop *to);
+    void applyListenOptions(Acceptor *acceptor);
+    TcpConnectionPtr createConnection(EventLoop *ioLoop, const std::string &connName, int sockfd, const InetAddress &peerAddr);
+    void startLoopAcceptors();
+    void newLoopConnection(LoopAcceptor *local, int sockfd, const InetAddress &peerAddr);
+    void removeLoopConnection(LoopAcceptor *local, const TcpConnectionPtr &conn);
+
+    void newConnection(int sockfd, const InetAddress &peerAddr);
+    void handOffConnections();   // 把这一批新连接交给各自的 subLoop
+    void removeConnection(const TcpConnectionPtr &conn);
+    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;            // baseLoop 用户定义的loop
+
+    const std::string ipPort_;
+    const std::string name_;
+    const InetAddress listenAddr_;
+    const Option option_;
+
+    std::unique_ptr<Acceptor> acceptor_;              // 运行在mainLoop 任务就是监听新连接事件 kReusePortPerLoop 模式下为空
+    std::vector<std::unique_ptr<LoopAcceptor>> loopAcceptors_;
+    int acceptBatch_;
+    bool cpuSteering_;
+    Options options_;
+
+    std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
+
+    ConnectionCallback connectionCallback_;       // 有新连接时的回调
+    MessageCallback messageCallback_;             // 有读写消息时的回调
+    WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
+
+    ThreadInitCallback threadInitCallback_;       // loop线程初始化的回调
+
+    std::atomic_int started_;
+
+    int nextConnId_;
+    ConnectionMap connections_;  // 保存所有的连接 只在 mainLoop 中访问
+    std::unordered_map<std::string, uint64_t> lastBytesReceived_;   // 上次 rebalance 时各连接收到的字节数 只在 mainLoop 中访问
+
+    // 迁移在各 subLoop 中发起 下面几个由 migrationMutex_ 保护
+    std::mutex migrationMutex_;
+    std::vector<EventLoop *> migrationTargets_;                // 可以迁入的 loop 缩容时先摘掉要退出的 loop
+    std::unordered_map<EventLoop *, int> migrationsInFlight_;  // 目标 loop => 已经发起还没完成的迁移数
+    size_t nextMigrationTarget_;
+    int waitingResize_;          // 等迁移完成的缩容 -1 表示没有
+
+    // 本批 accept 到 还没交给 subLoop 的连接 按 subLoop 分组 subLoop 不多 线性查找
+    std::vector<std::pair<EventLoop *, std::vector<TcpConnectionPtr>>> pendingConnections_;
+};
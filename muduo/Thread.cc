@@ -42,7 +42,8 @@ void Thread::start()             // 一个Thread对象 记录的就是一个新
 // C++ std::thread 中join()和detach()的区别：https://blog.nowcoder.net/n/8fcd9bb6e2e94d9596cf0a45c8e5858a
 void Thread::join()
 {
-
+    joined_ = true;
+    thread_->join();            // 等待线程执行完毕
 }
 
 void Thread::setDefaultName()
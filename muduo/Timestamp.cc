@@ -1,7 +1,16 @@
 #include <time.h>
+#include <string.h>
 
 #include "Timestamp.h"
 
+// 每个线程缓存最近一次格式化的秒 以及 "2022/06/01 12:00:00" 这个前缀
+__thread time_t t_lastSecond = -1;
+__thread char t_secondPrefix[32];
+__thread int t_secondPrefixLen = 0;
+
+// EventLoop 每轮 poll 返回后刷新
+__thread int64_t t_cachedNow = 0;
+
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0)
 {
 }
@@ -13,24 +22,76 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+Timestamp Timestamp::cachedNow()
+{
+    if (t_cachedNow == 0)           // 当前线程没有运行 EventLoop
+    {
+        return now();
+    }
+    return Timestamp(t_cachedNow);
+}
+
+void Timestamp::setCachedNow(Timestamp now)
+{
+    t_cachedNow = now.microSecondsSinceEpoch_;
 }
+
+int Timestamp::formatTo(char *buf, bool showMicroseconds) const
+{
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)    // 跨秒了才调用 localtime_r 和 snprintf
+    {
+        tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        t_secondPrefixLen = snprintf(t_secondPrefix, sizeof t_secondPrefix, "%4d/%02d/%02d %02d:%02d:%02d",
+                                     tm_time.tm_year + 1900,
+                                     tm_time.tm_mon + 1,
+                                     tm_time.tm_mday,
+                                     tm_time.tm_hour,
+                                     tm_time.tm_min,
+                                     tm_time.tm_sec);
+        t_lastSecond = seconds;
+    }
+
+    ::memcpy(buf, t_secondPrefix, t_secondPrefixLen);
+    int len = t_secondPrefixLen;
+    if (showMicroseconds)
+    {
+        int micro = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        buf[len] = '.';
+        for (int i = 6; i > 0; --i)
+        {
+            buf[len + i] = static_cast<char>('0' + micro % 10);
+            micro /= 10;
+        }
+        len += 7;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-    return buf;
+    char buf[32];
+    int len = formatTo(buf, false);
+    return std::string(buf, len);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[32];
+    int len = formatTo(buf, showMicroseconds);
+    return std::string(buf, len);
 }
 
 // #include <iostream>
 // int main() {
 //     std::cout << Timestamp::now().toString() << std::endl;
+//     std::cout << Timestamp::now().toFormattedString() << std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
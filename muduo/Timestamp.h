@@ -8,9 +8,42 @@ class Timestamp
 public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
+    // clock_gettime(CLOCK_REALTIME) 走 vDSO 微秒精度
     static Timestamp now();
+    // 当前线程 EventLoop 本轮 poll 返回的时间 每轮循环刷新一次 不需要更高精度的地方用它省掉一次 clock_gettime
+    static Timestamp cachedNow();
+    static void setCachedNow(Timestamp now);
+
+    // 2022/06/01 12:00:00
     std::string toString() const;
+    // 2022/06/01 12:00:00.123456 同一秒内复用当前线程缓存的日期和秒 只需拷贝几次内存
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 写入 buf 返回写入的长度 buf 至少 32 字节
+    int formatTo(char *buf, bool showMicroseconds = true) const;
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点之间相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
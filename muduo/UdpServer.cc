@@ -0,0 +1,304 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/udp.h>
+
+#include <algorithm>
+
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+    // 每个 msghdr 的 cmsg 空间 接收放 UDP_GRO 的段长(int) 发送放 UDP_SEGMENT 的段长(uint16_t)
+    const size_t kControlSpace = CMSG_SPACE(sizeof(int));
+    // 一次 GSO 发送最多的段数和总长度
+    const size_t kMaxGsoSegments = 64;
+    const size_t kMaxGsoBytes = 65000;
+    // IPv4 上一个 UDP 数据报最多的负载 65535 - 20(IP) - 8(UDP)
+    const size_t kMaxUdpPayload = 65507;
+}
+
+static int createNonblockingUdp()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option)
+    : loop_(loop)
+    , name_(nameArg)
+    , socket_(createNonblockingUdp())
+    , channel_(loop, socket_.fd())
+    , batchSize_(kMaxBatch)
+    , maxDatagramSize_(kDefaultMaxDatagramSize)
+    , gro_(false)
+    , gsoSupported_(false)
+    , slotSize_(0)
+    , sendMsgs_(kMaxBatch)
+    , sendIovecs_(kMaxBatch)
+    , sendControl_(kMaxBatch * kControlSpace)
+    , flushScheduled_(false)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(option == kReusePort);
+    socket_.bindAddress(listenAddr);
+    gsoSupported_ = socket_.udpGsoSupported();
+    channel_.setReadCallback(std::bind(&UdpServer::handleRead, this, std::placeholders::_1));
+}
+
+UdpServer::~UdpServer()
+{
+    channel_.disableAll();
+    channel_.remove();
+}
+
+bool UdpServer::setGro(bool on)
+{
+    if (!socket_.setUdpGro(on))
+    {
+        return false;
+    }
+    gro_ = on;
+    return true;
+}
+
+void UdpServer::start()
+{
+    loop_->runInLoop(std::bind(&UdpServer::startInLoop, this));
+}
+
+void UdpServer::startInLoop()
+{
+    if (channel_.isReading())
+    {
+        return;
+    }
+
+    // GRO 合并后的数据报可能到 64K
+    slotSize_ = maxDatagramSize_;
+    if (gro_ && slotSize_ < kGroBufferSize)
+    {
+        slotSize_ = kGroBufferSize;
+    }
+    recvBuffer_.resize(batchSize_ * slotSize_);
+    recvMsgs_.resize(batchSize_);
+    recvIovecs_.resize(batchSize_);
+    recvAddrs_.resize(batchSize_);
+    recvControl_.resize(batchSize_ * kControlSpace);
+    for (int i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * slotSize_];
+        recvIovecs_[i].iov_len = slotSize_;
+        struct msghdr &msg = recvMsgs_[i].msg_hdr;
+        ::memset(&msg, 0, sizeof msg);
+        msg.msg_name = &recvAddrs_[i];
+        msg.msg_namelen = sizeof(sockaddr_in);
+        msg.msg_iov = &recvIovecs_[i];
+        msg.msg_iovlen = 1;
+        msg.msg_control = gro_ ? &recvControl_[i * kControlSpace] : nullptr;
+        msg.msg_controllen = gro_ ? kControlSpace : 0;
+    }
+    channel_.enableReading();
+}
+
+void UdpServer::handleRead(Timestamp receiveTime)
+{
+    int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, 0, nullptr);
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "UdpServer::handleRead [%s] errno:%d\n", name_.c_str(), errno);
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        struct msghdr &msg = recvMsgs_[i].msg_hdr;
+        const char *data = &recvBuffer_[i * slotSize_];
+        size_t len = recvMsgs_[i].msg_len;
+        if (msg.msg_flags & MSG_TRUNC)
+        {
+            LOG_ERROR_RATELIMITED(5, 1, "UdpServer::handleRead [%s] datagram larger than %zu dropped\n", name_.c_str(), slotSize_);
+        }
+        else if (messageCallback_)
+        {
+            // GRO 合并的缓冲按段长切回一个个数据报 最后一段可能短一些
+            size_t segmentSize = len;
+            if (gro_)
+            {
+                for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gsoSize;
+                        ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                        segmentSize = gsoSize;
+                    }
+                }
+            }
+            InetAddress peer(recvAddrs_[i]);
+            size_t offset = 0;
+            do
+            {
+                size_t piece = std::min(segmentSize, len - offset);
+                messageCallback_(this, data + offset, piece, peer, receiveTime);
+                offset += piece;
+            } while (offset < len);
+        }
+
+        // 内核会改写这几个字段 下一次 recvmmsg 之前恢复
+        msg.msg_namelen = sizeof(sockaddr_in);
+        msg.msg_controllen = gro_ ? kControlSpace : 0;
+        msg.msg_flags = 0;
+    }
+
+    // 这一批数据报回调里产生的回复一起发出
+    if (!pendingSends_.empty())
+    {
+        flushSends();
+    }
+}
+
+void UdpServer::sendTo(const char *data, size_t len, const InetAddress &peer)
+{
+    if (loop_->isInLoopThread())
+    {
+        queueDatagram(data, len, 0, *peer.getSockAddr());
+    }
+    else
+    {
+        std::string message(data, len);
+        sockaddr_in addr = *peer.getSockAddr();
+        loop_->queueInLoop([this, message, addr]() { queueDatagram(message.data(), message.size(), 0, addr); });
+    }
+}
+
+void UdpServer::sendSegments(const char *data, size_t len, size_t segmentSize, const InetAddress &peer)
+{
+    if (loop_->isInLoopThread())
+    {
+        queueSegments(data, len, segmentSize, *peer.getSockAddr());
+    }
+    else
+    {
+        std::string message(data, len);
+        sockaddr_in addr = *peer.getSockAddr();
+        loop_->queueInLoop([this, message, segmentSize, addr]() {
+            queueSegments(message.data(), message.size(), segmentSize, addr);
+        });
+    }
+}
+
+// 每次 GSO 发送不超过 kMaxGsoSegments 段和 kMaxGsoBytes 字节 内核不支持 GSO 或者段太大时每段单独排队
+void UdpServer::queueSegments(const char *data, size_t len, size_t segmentSize, const sockaddr_in &peer)
+{
+    if (segmentSize == 0 || segmentSize >= len)
+    {
+        queueDatagram(data, len, 0, peer);
+        return;
+    }
+    if (segmentSize > kMaxUdpPayload)
+    {
+        LOG_ERROR("UdpServer::sendSegments [%s] segment size %zu exceeds max UDP payload, dropped\n", name_.c_str(), segmentSize);
+        return;
+    }
+
+    // 段长超过 kMaxGsoBytes 时一次只能发一段 至少为 1 否则下面的循环不会前进
+    size_t segmentsPerSend = gsoSupported_ ? std::min(kMaxGsoSegments, kMaxGsoBytes / segmentSize) : 1;
+    if (segmentsPerSend == 0)
+    {
+        segmentsPerSend = 1;
+    }
+    size_t bytesPerSend = segmentsPerSend * segmentSize;
+    for (size_t offset = 0; offset < len; offset += bytesPerSend)
+    {
+        size_t chunk = std::min(bytesPerSend, len - offset);
+        uint16_t gsoSize = chunk > segmentSize ? static_cast<uint16_t>(segmentSize) : 0;
+        queueDatagram(data + offset, chunk, gsoSize, peer);
+    }
+}
+
+void UdpServer::queueDatagram(const char *data, size_t len, uint16_t segmentSize, const sockaddr_in &peer)
+{
+    PendingDatagram datagram;
+    datagram.offset = sendData_.size();
+    datagram.len = len;
+    datagram.segmentSize = segmentSize;
+    datagram.peer = peer;
+    sendData_.append(data, len);
+    pendingSends_.push_back(datagram);
+
+    if (pendingSends_.size() >= static_cast<size_t>(batchSize_))
+    {
+        flushSends();
+    }
+    else if (!flushScheduled_)
+    {
+        flushScheduled_ = true;
+        loop_->runAfterIteration(std::bind(&UdpServer::flushScheduledSends, this));
+    }
+}
+
+void UdpServer::flushScheduledSends()
+{
+    flushScheduled_ = false;
+    if (!pendingSends_.empty())
+    {
+        flushSends();
+    }
+}
+
+// 每次 sendmmsg 最多 batchSize_ 项 UDP 允许丢包 发送出错时丢掉剩下的 不关注写事件
+void UdpServer::flushSends()
+{
+    size_t next = 0;
+    while (next < pendingSends_.size())
+    {
+        int count = static_cast<int>(std::min(static_cast<size_t>(batchSize_), pendingSends_.size() - next));
+        for (int i = 0; i < count; ++i)
+        {
+            PendingDatagram &datagram = pendingSends_[next + i];
+            sendIovecs_[i].iov_base = &sendData_[datagram.offset];
+            sendIovecs_[i].iov_len = datagram.len;
+            struct msghdr &msg = sendMsgs_[i].msg_hdr;
+            ::memset(&msg, 0, sizeof msg);
+            msg.msg_name = &datagram.peer;
+            msg.msg_namelen = sizeof(sockaddr_in);
+            msg.msg_iov = &sendIovecs_[i];
+            msg.msg_iovlen = 1;
+            if (datagram.segmentSize != 0)
+            {
+                msg.msg_control = &sendControl_[i * kControlSpace];
+                msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                ::memcpy(CMSG_DATA(cmsg), &datagram.segmentSize, sizeof(uint16_t));
+            }
+        }
+
+        int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), count, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR_RATELIMITED(5, 1, "UdpServer::flushSends [%s] errno:%d, %zu datagrams dropped\n",
+                                  name_.c_str(), errno, pendingSends_.size() - next);
+            break;
+        }
+        next += n;               // 第 n 项出错时下一次 sendmmsg 从它开始 还失败就丢掉剩下的
+    }
+    pendingSends_.clear();
+    sendData_.clear();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "noncopyable.h"
+#include "Channel.h"
+#include "Socket.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+class EventLoop;
+
+/**
+ * 绑定在一个 EventLoop 上的 UDP 服务端 要用多个 loop 时每个 loop 建一个 kReusePort 的 UdpServer 由内核分配数据报
+ * 每次可读事件用一次 recvmmsg 最多收 batchSize_ 个数据报 逐个交给 messageCallback_
+ * sendTo 只把数据报攒进 pendingSends_ 这一批数据报处理完 攒满 batchSize_ 个 或者本轮循环末尾时用 sendmmsg 一次发出
+ * batchSize 为 1 时退化成每个数据报一次系统调用
+ *
+ * 打开 GRO 后内核把同一来源的多个数据报合成一个大缓冲交上来 这里按 cmsg 里的段长切开 回调看到的还是单个数据报
+ * sendSegments 用 UDP_SEGMENT(GSO) 把一大块数据按段长切成多个数据报 一次 sendmmsg 的一项就能发出几十个 内核不支持时逐个排队
+ **/
+class UdpServer : noncopyable
+{
+public:
+    using MessageCallback = std::function<void(UdpServer *, const char *data, size_t len,
+                                               const InetAddress &peer, Timestamp receiveTime)>;
+
+    enum Option
+    {
+        kNoReusePort,
+        kReusePort,
+    };
+
+    static const int kMaxBatch = 64;
+    static const size_t kDefaultMaxDatagramSize = 2048;  // 更大的数据报会被截断丢弃 需要时用 setMaxDatagramSize 调大
+    static const size_t kGroBufferSize = 65536;          // GRO 合并后的缓冲最大 64K
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option = kNoReusePort);
+    ~UdpServer();
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+
+    // 下面几个在 start() 之前调用
+    // 每次 recvmmsg/sendmmsg 最多的数据报个数 1 到 kMaxBatch
+    void setBatchSize(int batch) { batchSize_ = batch < 1 ? 1 : (batch > kMaxBatch ? kMaxBatch : batch); }
+    void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+    // 内核不支持 UDP_GRO 时返回 false
+    bool setGro(bool on);
+
+    // 开始接收 任意线程都可以调用
+    void start();
+
+    // 发送一个数据报 任意线程都可以调用 数据会被拷贝
+    void sendTo(const char *data, size_t len, const InetAddress &peer);
+    // 把 data 按 segmentSize 切成多个数据报发给 peer 最后一段可以短一些 任意线程都可以调用
+    void sendSegments(const char *data, size_t len, size_t segmentSize, const InetAddress &peer);
+
+private:
+    // 一个待发送的项 数据在 sendData_ 中 segmentSize 非 0 时是一个 GSO 发送
+    struct PendingDatagram
+    {
+        size_t offset;
+        size_t len;
+        uint16_t segmentSize;
+        sockaddr_in peer;
+    };
+
+    void startInLoop();
+    void handleRead(Timestamp receiveTime);
+    void queueDatagram(const char *data, size_t len, uint16_t segmentSize, const sockaddr_in &peer);
+    void queueSegments(const char *data, size_t len, size_t segmentSize, const sockaddr_in &peer);
+    void flushSends();
+    void flushScheduledSends();
+
+    EventLoop *loop_;
+    const std::string name_;
+    Socket socket_;
+    Channel channel_;
+    MessageCallback messageCallback_;
+
+    int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    bool gsoSupported_;
+
+    // 接收 每个槽一块缓冲 start() 时按 batchSize_ 分配
+    size_t slotSize_;
+    std::vector<char> recvBuffer_;
+    std::vector<struct mmsghdr> recvMsgs_;
+    std::vector<struct iovec> recvIovecs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<char> recvControl_;
+
+    // 发送
+    std::string sendData_;
+    std::vector<PendingDatagram> pendingSends_;
+    std::vector<struct mmsghdr> sendMsgs_;
+    std::vector<struct iovec> sendIovecs_;
+    std::vector<char> sendControl_;
+    bool flushScheduled_;        // 已经登记了本轮末尾的 flushScheduledSends
+};
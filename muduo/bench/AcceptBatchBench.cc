@@ -0,0 +1,66 @@
+// 接受连接的速率 客户端线程不停地 connect 再 close 对比每次可读事件 accept 1 个和 acceptBatch 个
+// ./AcceptBatchBench 1 && ./AcceptBatchBench 16
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const int kClientThreads = 4;
+const int kSeconds = 3;
+
+int main(int argc, char *argv[])
+{
+    int batch = argc > 1 ? atoi(argv[1]) : Acceptor::kDefaultAcceptBatch;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(9982);
+    TcpServer server(&loop, listenAddr, "AcceptBench");
+    server.setThreadNum(2);
+    server.setAcceptBatch(batch);
+    std::atomic<int> accepted(0);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            ++accepted;
+        }
+    });
+    server.start();
+
+    std::atomic_bool running(true);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClientThreads; ++i)
+    {
+        clients.emplace_back([&] {
+            while (running)
+            {
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                if (::connect(fd, (sockaddr *)listenAddr.getSockAddr(), sizeof(sockaddr_in)) == 0)
+                {
+                    ::close(fd);
+                }
+                else
+                {
+                    ::close(fd);
+                    ::usleep(1000);
+                }
+            }
+        });
+    }
+
+    std::thread timer([&] {
+        ::sleep(kSeconds);
+        running = false;
+        loop.quit();
+    });
+    loop.loop();
+    timer.join();
+    for (auto &client : clients)
+    {
+        client.join();
+    }
+    printf("batch %d: %.0f connections/s\n", batch, accepted.load() / static_cast<double>(kSeconds));
+}
@@ -0,0 +1,40 @@
+// 16 个线程写日志的吞吐 同步输出到标准输出 对比 AsyncLogging
+// ./AsyncLoggingBench > sync.log && ./AsyncLoggingBench async
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "AsyncLogging.h"
+#include "Logger.h"
+
+const int kThreads = 16;
+const int kLines = 100000;
+
+int main(int argc, char *argv[])
+{
+    bool async = argc > 1;
+    AsyncLogging log("bench", 500 * 1000 * 1000);
+    if (async)
+    {
+        log.start();
+        Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([t] {
+            for (int i = 0; i < kLines; ++i)
+            {
+                LOG_INFO("thread %d line %d hello world abcdefghijklmnopqrstuvwxyz", t, i);
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%s: %.0f lines/s\n", async ? "async" : "sync", kThreads * kLines / seconds);
+}
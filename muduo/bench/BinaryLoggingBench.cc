@@ -0,0 +1,52 @@
+// 调用方的吞吐和单次调用耗时 BinaryLogging 对比 AsyncLogging
+// ./BinaryLoggingBench binary && ./BinaryLoggingBench
+#include <chrono>
+#include <thread>
+#include "AsyncLogging.h"
+
+const int kThreads = 4;
+const int kLines = 200000;
+
+int main(int argc, char *argv[])
+{
+    bool binary = argc > 1;
+    BinaryLogging binaryLog("trace", 500 * 1000 * 1000);
+    AsyncLogging asyncLog("async", 500 * 1000 * 1000);
+    if (binary)
+    {
+        binaryLog.start();
+    }
+    else
+    {
+        asyncLog.start();
+        Logger::instance().setOutput(std::bind(&AsyncLogging::append, &asyncLog, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([t] {
+            for (int i = 0; i < kLines; ++i)
+            {
+                LOG_INFO("thread %d request %d latency %.2f us path %s", t, i, i * 0.5, "/index.html");
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%s: %.1f ns/call, %.0f calls/s\n", binary ? "binary" : "async",
+            seconds * 1e9 / kLines, kThreads * kLines / seconds);
+
+    if (binary)
+    {
+        binaryLog.stop();
+    }
+    else
+    {
+        asyncLog.stop();
+    }
+}
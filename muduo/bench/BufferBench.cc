@@ -0,0 +1,72 @@
+// 空闲连接的内存占用 以及读吞吐 Buffer(初始 1K + readv 64K 栈缓冲) 对比每个连接固定 64K 的缓冲
+// ./BufferBench
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <thread>
+#include "Buffer.h"
+
+const int kIdleConnections = 10000;
+const size_t kFixedSize = 65536;
+const size_t kTotalBytes = 1024 * 1024 * 1024;
+
+// 对端不停地写 每次写 chunk 字节 读端一次读完一批就全部消费掉
+template <typename ReadFunc>
+double readThroughput(ReadFunc readOnce)
+{
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::thread writer([&] {
+        std::vector<char> chunk(256 * 1024, 'x');
+        size_t sent = 0;
+        while (sent < kTotalBytes)
+        {
+            ssize_t n = ::write(fds[1], chunk.data(), chunk.size());
+            if (n <= 0) break;
+            sent += n;
+        }
+        ::close(fds[1]);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    size_t received = 0;
+    ssize_t n;
+    while ((n = readOnce(fds[0])) > 0)
+    {
+        received += n;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer.join();
+    ::close(fds[0]);
+    return received / seconds / 1024 / 1024;
+}
+
+int main()
+{
+    {
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        for (int i = 0; i < kIdleConnections; ++i)
+        {
+            buffers.emplace_back(new Buffer);
+        }
+        printf("idle connection: Buffer %zu bytes, fixed %zu bytes\n", buffers[0]->internalCapacity(), kFixedSize);
+        printf("%d idle connections: Buffer %zu KB, fixed %zu KB\n", kIdleConnections,
+               kIdleConnections * buffers[0]->internalCapacity() / 1024, kIdleConnections * kFixedSize / 1024);
+    }
+
+    Buffer buffer;
+    double readv = readThroughput([&](int fd) {
+        int savedErrno = 0;
+        ssize_t n = buffer.readFd(fd, &savedErrno);
+        buffer.retrieveAll();
+        return n;
+    });
+
+    std::vector<char> fixed(kFixedSize);
+    double plain = readThroughput([&](int fd) { return ::read(fd, fixed.data(), fixed.size()); });
+
+    printf("readv Buffer %.0f MB/s, fixed 64K %.0f MB/s\n", readv, plain);
+}
@@ -0,0 +1,73 @@
+// 64K 的响应(头部 + 缓存的正文 + 尾部) ChainBuffer 的 writev 对比拷进连续的 Buffer 再 write
+// ./ChainBufferBench
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Buffer.h"
+#include "ChainBuffer.h"
+
+const int kResponses = 20000;
+
+template <typename SendFunc>
+double serve(const char *name, SendFunc sendOne)
+{
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::thread reader([&] {
+        std::vector<char> buf(256 * 1024);
+        while (::read(fds[1], buf.data(), buf.size()) > 0)
+        {
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    size_t copied = 0;
+    for (int i = 0; i < kResponses; ++i)
+    {
+        copied += sendOne(fds[0]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ::close(fds[0]);
+    reader.join();
+    ::close(fds[1]);
+    printf("%s: %.0f responses/s, %.1f MB copied\n", name, kResponses / seconds, copied / 1024.0 / 1024.0);
+    return seconds;
+}
+
+int main()
+{
+    const std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: 65536\r\n\r\n";
+    const std::string trailer = "\r\n";
+    ChainBuffer::Block body = std::make_shared<std::string>(65536, 'x');
+
+    serve("contiguous Buffer", [&](int fd) {
+        Buffer output;
+        output.append(header);
+        output.append(*body);
+        output.append(trailer);
+        size_t copied = output.readableBytes();
+        int savedErrno = 0;
+        while (output.readableBytes() > 0)
+        {
+            ssize_t n = output.writeFd(fd, &savedErrno);
+            output.retrieve(n);
+        }
+        return copied;
+    });
+
+    serve("ChainBuffer writev", [&](int fd) {
+        ChainBuffer output;
+        output.append(header);
+        output.append(body);
+        output.append(trailer);
+        int savedErrno = 0;
+        while (output.readableBytes() > 0)
+        {
+            output.writeFd(fd, &savedErrno);
+        }
+        return output.bytesCopied();
+    });
+}
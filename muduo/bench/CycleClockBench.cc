@@ -0,0 +1,37 @@
+// 对比 CycleClock::now() 与 Timestamp::now() 的开销 以及运行一段时间后 TSC 换算结果相对 CLOCK_MONOTONIC 的漂移
+// ./CycleClockBench
+#include <stdio.h>
+#include <unistd.h>
+#include "Timestamp.h"
+#include "CycleClock.h"
+
+int main()
+{
+    const int kN = 10 * 1000 * 1000;
+    printf("invariant tsc: %d, %.3f cycles/ns\n", CycleClock::usingTsc(), CycleClock::cyclesPerNanoSecond());
+
+    uint64_t sink = 0;
+    uint64_t start = CycleClock::monotonicNanoSeconds();
+    for (int i = 0; i < kN; ++i)
+    {
+        sink += CycleClock::now();
+    }
+    uint64_t mid = CycleClock::monotonicNanoSeconds();
+    for (int i = 0; i < kN; ++i)
+    {
+        sink += Timestamp::now().microSecondsSinceEpoch();
+    }
+    uint64_t end = CycleClock::monotonicNanoSeconds();
+    printf("CycleClock::now %.1f ns/call, Timestamp::now %.1f ns/call (%lu)\n",
+           (mid - start) / double(kN), (end - mid) / double(kN), sink % 10);
+
+    uint64_t startNs = CycleClock::monotonicNanoSeconds();
+    uint64_t startCycles = CycleClock::now();
+    for (int i = 1; i <= 10; ++i)
+    {
+        sleep(1);
+        int64_t monotonic = CycleClock::monotonicNanoSeconds() - startNs;
+        int64_t tsc = CycleClock::toNanoSeconds(CycleClock::now() - startCycles);
+        printf("%2ds drift %+ld ns\n", i, tsc - monotonic);
+    }
+}
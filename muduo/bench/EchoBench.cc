@@ -0,0 +1,106 @@
+// 10000 个连接的回环 echo 每轮每个连接发 64 字节并等回显 统计吞吐和每个连接占用的用户态内存
+// ./EchoBench
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "EventLoopThread.h"
+#include "TcpServer.h"
+#include "Logger.h"
+
+const int kConnections = 10000;
+const int kRounds = 20;
+const size_t kMessageSize = 64;
+
+static long rssKB()
+{
+    long kb = 0;
+    FILE *fp = ::fopen("/proc/self/status", "r");
+    char line[256];
+    while (::fgets(line, sizeof line, fp))
+    {
+        if (::sscanf(line, "VmRSS: %ld kB", &kb) == 1)
+        {
+            break;
+        }
+    }
+    ::fclose(fp);
+    return kb;
+}
+
+int main()
+{
+    // 客户端和服务端各占一个 fd 受硬限制约束时少开一些连接
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+    const int connectionCount = std::min<long>(kConnections, (static_cast<long>(rl.rlim_cur) - 64) / 2);
+
+    EventLoopThread serverThread;
+    EventLoop *loop = serverThread.startLoop();
+
+    InetAddress listenAddr(9981);
+    Socket listener(::socket(AF_INET, SOCK_STREAM, 0));
+    listener.setReuseAddr(true);
+    listener.bindAddress(listenAddr);
+    ::listen(listener.fd(), 65535);
+
+    long rssBefore = rssKB();
+    std::vector<int> clients;
+    std::vector<TcpConnectionPtr> connections;
+    for (int i = 0; i < connectionCount; ++i)
+    {
+        int client = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(client, (sockaddr *)listenAddr.getSockAddr(), sizeof(sockaddr_in));
+        clients.push_back(client);
+
+        InetAddress peerAddr(0);
+        int connfd = listener.accept(&peerAddr);
+        TcpConnectionPtr conn(new TcpConnection(loop, "echo", connfd, listenAddr, peerAddr));
+        conn->setMessageCallback([](const TcpConnectionPtr &c, Buffer *buf, Timestamp) {
+            c->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        });
+        loop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+        connections.push_back(conn);
+    }
+    ::usleep(100 * 1000);
+    long rssAfter = rssKB();
+
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round)
+    {
+        for (int fd : clients)
+        {
+            ::write(fd, message, sizeof message);
+        }
+        for (int fd : clients)
+        {
+            size_t received = 0;
+            while (received < kMessageSize)
+            {
+                received += ::read(fd, message, sizeof message - received);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d connections: %.0f echoes/s, %.1f MB/s, %.2f KB RSS per connection\n", connectionCount,
+           connectionCount * kRounds / seconds, connectionCount * kRounds * kMessageSize / seconds / 1024 / 1024,
+           static_cast<double>(rssAfter - rssBefore) / connectionCount);
+
+    for (auto &conn : connections)
+    {
+        loop->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    }
+    ::usleep(100 * 1000);
+    for (int fd : clients)
+    {
+        ::close(fd);
+    }
+}
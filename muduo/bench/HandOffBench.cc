@@ -0,0 +1,64 @@
+// 连接风暴下 mainLoop 的开销 acceptBatch 为 1 时每个连接单独交给 subLoop(一次 queueInLoop 加一次 wakeup)
+// 大于 1 时一批连接按 subLoop 分组 每个 subLoop 一次 统计连接速率和 mainLoop 每个连接的忙碌时间
+// ./HandOffBench 1 && ./HandOffBench 64
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const int kClientThreads = 8;
+const int kSeconds = 3;
+
+int main(int argc, char *argv[])
+{
+    int batch = argc > 1 ? atoi(argv[1]) : Acceptor::kDefaultAcceptBatch;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(9984);
+    TcpServer server(&loop, listenAddr, "HandOffBench");
+    server.setThreadNum(4);
+    server.setAcceptBatch(batch);
+    std::atomic<int> established(0);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            ++established;
+            conn->shutdown();
+        }
+    });
+    server.start();
+
+    std::atomic_bool running(true);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClientThreads; ++i)
+    {
+        clients.emplace_back([&] {
+            while (running)
+            {
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                ::connect(fd, (sockaddr *)listenAddr.getSockAddr(), sizeof(sockaddr_in));
+                ::close(fd);
+            }
+        });
+    }
+
+    std::thread timer([&] {
+        ::sleep(kSeconds);
+        running = false;
+        loop.quit();
+    });
+    int64_t busyStart = loop.busyMicroSeconds();
+    loop.loop();
+    int64_t busy = loop.busyMicroSeconds() - busyStart;
+    timer.join();
+    for (auto &client : clients)
+    {
+        client.join();
+    }
+    printf("batch %d: %.0f connections/s, main loop %.2f us/connection\n", batch,
+           established.load() / static_cast<double>(kSeconds), static_cast<double>(busy) / established.load());
+}
@@ -0,0 +1,44 @@
+// 流式读写 每次追加一个 TCP 段 只消费一部分 Buffer 在空间用完时要把剩下的数据 memmove 到开头 MirroredBuffer 不需要
+// backlog 是消费者落后的字节数 落后越多 Buffer 每次挪动的数据越多
+// ./MirroredBufferBench
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "Buffer.h"
+#include "MirroredBuffer.h"
+
+const int kRounds = 2000000;
+const size_t kChunk = 1460;      // 一个 TCP 段
+const size_t kConsume = 1000;    // 解析出一条消息 剩下半条留到下一次
+
+template <typename BufferType>
+void stream(const char *name, size_t backlog)
+{
+    BufferType buffer;
+    std::vector<char> chunk(kChunk, 'x');
+    char message[kConsume];
+    size_t consumed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; ++i)
+    {
+        buffer.append(chunk.data(), chunk.size());
+        while (buffer.readableBytes() >= backlog + kConsume)
+        {
+            ::memcpy(message, buffer.peek(), kConsume);
+            buffer.retrieve(kConsume);
+            consumed += message[0] == 'x';
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s backlog %zu: %.0f MB/s (%zu messages)\n", name, backlog, kRounds * kChunk / seconds / 1024 / 1024, consumed);
+}
+
+int main()
+{
+    for (size_t backlog : {0, 16 * 1024, 48 * 1024})
+    {
+        stream<Buffer>("Buffer", backlog);
+        stream<MirroredBuffer>("MirroredBuffer", backlog);
+    }
+}
@@ -0,0 +1,72 @@
+// 32 个 loop 并发读 对比 Shared<T> 与读写锁(本仓库使用 C++11 没有 std::shared_mutex 用 pthread_rwlock 代替)
+// ./RcuBench [rwlock] > /dev/null
+#include <pthread.h>
+#include <chrono>
+#include "Rcu.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+
+const int kLoops = 32;
+const int kReads = 2000000;
+
+struct Config { int version; };
+Shared<Config> sharedConfig(Config{0});
+Config lockedConfig{0};
+pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+std::atomic<int> finished(0);
+std::atomic<long> sink(0);
+
+int main(int argc, char *argv[])
+{
+    bool useLock = argc > 1;
+    EventLoop base;
+    EventLoopThreadPool pool(&base, "reader");
+    pool.setThreadNum(kLoops);
+    pool.start();
+
+    auto start = std::chrono::steady_clock::now();
+    for (EventLoop *loop : pool.getAllLoops())
+    {
+        loop->runInLoop([&] {
+            long sum = 0;
+            for (int i = 0; i < kReads; ++i)
+            {
+                if (useLock)
+                {
+                    pthread_rwlock_rdlock(&rwlock);
+                    sum += lockedConfig.version;
+                    pthread_rwlock_unlock(&rwlock);
+                }
+                else
+                {
+                    sum += sharedConfig->version;
+                }
+            }
+            sink += sum;
+            if (++finished == kLoops)
+            {
+                base.queueInLoop([&] { base.quit(); });   // base 可能还没进入 loop() 直接 quit 会被它重置
+            }
+        });
+    }
+    // 读的同时持续发布新版本
+    base.runInLoop([&] {
+        for (int i = 1; i <= 1000; ++i)
+        {
+            if (useLock)
+            {
+                pthread_rwlock_wrlock(&rwlock);
+                lockedConfig.version = i;
+                pthread_rwlock_unlock(&rwlock);
+            }
+            else
+            {
+                sharedConfig.update(Config{i});
+            }
+        }
+    });
+    base.loop();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%s: %.1fM reads/s\n", useLock ? "rwlock" : "Shared", kLoops * (double)kReads / seconds / 1e6);
+}
@@ -0,0 +1,75 @@
+// 短连接的接受速率和建连延迟 单个 Acceptor 加交接 对比每个 loop 一个 SO_REUSEPORT 的 Acceptor
+// 服务端在连接建立时发 1 字节 客户端计时从 connect 到收到这 1 字节
+// ./ReusePortBench single && ./ReusePortBench perloop
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const int kClientThreads = 8;
+const int kSeconds = 3;
+
+int main(int argc, char *argv[])
+{
+    bool perLoop = argc > 1 && ::strcmp(argv[1], "perloop") == 0;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(9985);
+    TcpServer server(&loop, listenAddr, "ReusePortBench", perLoop ? TcpServer::kReusePortPerLoop : TcpServer::kNoReusePort);
+    server.setThreadNum(4);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->send("x", 1);
+            conn->shutdown();
+        }
+    });
+    server.start();
+
+    std::atomic_bool running(true);
+    std::mutex mutex;
+    std::vector<double> latencies;
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClientThreads; ++i)
+    {
+        clients.emplace_back([&] {
+            std::vector<double> local;
+            while (running)
+            {
+                auto start = std::chrono::steady_clock::now();
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                char c;
+                if (::connect(fd, (sockaddr *)listenAddr.getSockAddr(), sizeof(sockaddr_in)) == 0 && ::read(fd, &c, 1) == 1)
+                {
+                    local.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+                }
+                ::close(fd);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.insert(latencies.end(), local.begin(), local.end());
+        });
+    }
+
+    std::thread timer([&] {
+        ::sleep(kSeconds);
+        running = false;
+        loop.quit();
+    });
+    loop.loop();
+    timer.join();
+    for (auto &client : clients)
+    {
+        client.join();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("%s: %.0f connections/s, p50 %.0f us, p99 %.0f us\n", perLoop ? "per-loop reuseport" : "single acceptor",
+           latencies.size() / static_cast<double>(kSeconds),
+           latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+}
@@ -0,0 +1,115 @@
+// 从页缓存发送大文件 对比 sendFile 和 pread 到用户态再 send(每次 64K 写完再读下一块)
+// 客户端在子进程中接收 服务端的 CPU 时间取自 getrusage
+// ./SendFileBench && ./SendFileBench copy
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const size_t kChunk = 64 * 1024;
+
+static double cpuSeconds()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void receive(const InetAddress &serverAddr, size_t total)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::connect(fd, (sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+    std::unique_ptr<char[]> buf(new char[256 * 1024]);
+    size_t received = 0;
+    ssize_t n;
+    while (received < total && (n = ::read(fd, buf.get(), 256 * 1024)) > 0)
+    {
+        received += n;
+    }
+    ::close(fd);
+}
+
+static void runOnce(size_t fileSize, bool copy)
+{
+    const char *path = "/tmp/sendfile_bench.bin";
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    std::string block(1024 * 1024, 'x');
+    for (size_t written = 0; written < fileSize; written += block.size())
+    {
+        ::write(fd, block.data(), std::min(block.size(), fileSize - written));
+    }
+
+    EventLoop loop;
+    InetAddress listenAddr(9989);
+    TcpServer server(&loop, listenAddr, "SendFileBench");
+    // copy 模式每发完一块再 pread 下一块
+    off_t offset = 0;
+    std::string chunk(kChunk, '\0');
+    auto sendChunk = [&](const TcpConnectionPtr &conn) {
+        if (static_cast<size_t>(offset) < fileSize)
+        {
+            ssize_t n = ::pread(fd, &chunk[0], kChunk, offset);
+            offset += n;
+            conn->send(chunk.data(), n);
+        }
+    };
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            if (copy)
+            {
+                sendChunk(conn);
+            }
+            else
+            {
+                conn->sendFile(fd, 0, fileSize);
+            }
+        }
+    });
+    server.setWriteCompleteCallback([&](const TcpConnectionPtr &conn) {
+        if (copy)
+        {
+            sendChunk(conn);
+        }
+    });
+    server.start();
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        receive(listenAddr, fileSize);
+        ::_exit(0);
+    }
+    double cpuStart = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&] {
+        ::waitpid(child, nullptr, 0);
+        loop.quit();
+    });
+    loop.loop();
+    waiter.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = cpuSeconds() - cpuStart;
+    printf("%s %5zu MB: %7.0f MB/s, server cpu %.3f s (%.2f ms/MB)\n", copy ? "read+send" : "sendfile ",
+           fileSize >> 20, (fileSize >> 20) / seconds, cpu, cpu * 1000 / (fileSize >> 20));
+    ::close(fd);
+    ::unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    bool copy = argc > 1;
+    Logger::setLogLevel(ERROR);
+    for (size_t megabytes : {1, 16, 256, 1024})
+    {
+        runOnce(megabytes << 20, copy);
+    }
+}
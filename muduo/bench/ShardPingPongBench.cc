@@ -0,0 +1,53 @@
+// 跨分片 ping-pong 基准: submitTo(SPSC 队列) 对比 runInLoop(pendingFunctors_ + 互斥锁)
+// ./ShardPingPongBench [lock] > /dev/null
+#include <chrono>
+#include "ShardFuture.h"
+#include "EventLoopThreadPool.h"
+
+const int kRounds = 200000;
+std::chrono::steady_clock::time_point start;
+
+void report(const char *name, EventLoop *base)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%s ping-pong: %.0f round trips/s\n", name, kRounds / seconds);
+    base->quit();
+}
+
+void pingShard(EventLoop *peer, EventLoop *base, int left)
+{
+    if (left == 0)
+    {
+        return report("submitTo", base);
+    }
+    submitTo(peer, [left] { return left - 1; }).then([peer, base](int n) { pingShard(peer, base, n); });
+}
+
+void pingLock(EventLoop *self, EventLoop *peer, EventLoop *base, int left)
+{
+    if (left == 0)
+    {
+        return report("runInLoop", base);
+    }
+    peer->runInLoop([=] { self->runInLoop([=] { pingLock(self, peer, base, left - 1); }); });
+}
+
+int main(int argc, char *argv[])
+{
+    EventLoop base;
+    EventLoopThreadPool pool(&base, "shard");
+    pool.setThreadNum(2);
+    pool.start();
+    std::vector<EventLoop *> loops = pool.getAllLoops();
+
+    start = std::chrono::steady_clock::now();
+    if (argc > 1)
+    {
+        loops[0]->runInLoop([&] { pingLock(loops[0], loops[1], &base, kRounds); });
+    }
+    else
+    {
+        loops[0]->runInLoop([&] { pingShard(loops[1], &base, kRounds); });
+    }
+    base.loop();
+}
@@ -0,0 +1,89 @@
+// loopback 上经过代理单向转发 1GB 对比 kSplice 和 kCopy 客户端和后端在子进程中 代理进程的 CPU 取自 getrusage
+// ./TcpProxyBench && ./TcpProxyBench copy
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include "TcpProxy.h"
+#include "Acceptor.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+const size_t kTotal = 1UL << 30;
+
+static double cpuSeconds()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 后端收完就退出 客户端一直写到 kTotal
+static void runPeers(const InetAddress &proxyAddr, int backendListenFd)
+{
+    std::thread backend([backendListenFd] {
+        int fd = ::accept(backendListenFd, nullptr, nullptr);
+        std::unique_ptr<char[]> buf(new char[256 * 1024]);
+        while (::read(fd, buf.get(), 256 * 1024) > 0)
+        {
+        }
+        ::close(fd);
+    });
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::connect(fd, (sockaddr *)proxyAddr.getSockAddr(), sizeof(sockaddr_in));
+    std::string chunk(256 * 1024, 'p');
+    for (size_t sent = 0; sent < kTotal;)
+    {
+        ssize_t n = ::write(fd, chunk.data(), chunk.size());
+        if (n <= 0)
+        {
+            break;
+        }
+        sent += n;
+    }
+    ::shutdown(fd, SHUT_WR);
+    backend.join();
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    TcpProxy::Mode mode = argc > 1 ? TcpProxy::kCopy : TcpProxy::kSplice;
+    InetAddress proxyAddr(9985);
+    InetAddress backendAddr(9986);
+    int backendListenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(backendListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    ::bind(backendListenFd, (sockaddr *)backendAddr.getSockAddr(), sizeof(sockaddr_in));
+    ::listen(backendListenFd, 16);
+
+    EventLoop loop;
+    Acceptor acceptor(&loop, proxyAddr, false);
+    TcpProxy::TcpProxyPtr proxy;
+    acceptor.setNewConnectionCallback([&](int sockfd, const InetAddress &) {
+        int upstreamFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ::connect(upstreamFd, (sockaddr *)backendAddr.getSockAddr(), sizeof(sockaddr_in));
+        proxy = std::make_shared<TcpProxy>(&loop, "bench", sockfd, upstreamFd, mode);
+        proxy->setCloseCallback([&](const TcpProxy::TcpProxyPtr &) { loop.quit(); });
+        proxy->start();
+    });
+    acceptor.listen();
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        runPeers(proxyAddr, backendListenFd);
+        ::_exit(0);
+    }
+    double cpuStart = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    loop.loop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ::waitpid(child, nullptr, 0);
+    printf("%s: %.0f MB/s, proxy cpu %.3f s for %lu MB\n", mode == TcpProxy::kSplice ? "splice" : "copy  ",
+           (kTotal >> 20) / seconds, cpuSeconds() - cpuStart, (unsigned long)(proxy->bytesToUpstream() >> 20));
+}
@@ -0,0 +1,129 @@
+// loopback 上的 UDP 回显 对比每次系统调用一个数据报(batch 1)和 recvmmsg/sendmmsg 批量(batch 64)
+// gso 模式: 客户端每次用 UDP_SEGMENT 发 64 个数据报 服务端打开 GRO 回复用 sendSegments 合成一个 GSO 发送
+// 客户端在子进程中 用 sendmmsg 一直发 64 字节的数据报 服务端统计 kSeconds 内每秒处理的数据报和每个数据报的 CPU 时间
+// 单核机器上客户端和服务端抢 CPU 每秒处理的数据报受调度影响 每个数据报的 CPU 时间更能说明问题
+// 单核上服务端每次被唤醒都会抢占客户端 一次 recvmmsg 只能取到一两个 用 chrt -b 0 (SCHED_BATCH) 运行才能攒成批
+// ./UdpBatchBench
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string>
+#include <netinet/udp.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+const int kSeconds = 3;
+const size_t kPayload = 64;
+const int kClientBatch = 64;
+
+static double cpuSeconds()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void runClient(const InetAddress &serverAddr, bool gso)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    ::connect(fd, (sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+    std::string payload(kPayload * kClientBatch, 'u');
+    struct iovec iov[kClientBatch];
+    struct mmsghdr msgs[kClientBatch];
+    ::memset(msgs, 0, sizeof msgs);
+    for (int i = 0; i < kClientBatch; ++i)
+    {
+        iov[i].iov_base = &payload[i * kPayload];
+        iov[i].iov_len = kPayload;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    // gso 模式下一次 sendmsg 带 UDP_SEGMENT 发出整块
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    struct iovec whole = {&payload[0], payload.size()};
+    struct msghdr gsoMsg;
+    ::memset(&gsoMsg, 0, sizeof gsoMsg);
+    gsoMsg.msg_iov = &whole;
+    gsoMsg.msg_iovlen = 1;
+    gsoMsg.msg_control = control;
+    gsoMsg.msg_controllen = sizeof control;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&gsoMsg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segmentSize = kPayload;
+    ::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+
+    char buf[65536];
+    while (true)
+    {
+        if (gso)
+        {
+            ::sendmsg(fd, &gsoMsg, 0);
+        }
+        else
+        {
+            ::sendmmsg(fd, msgs, kClientBatch, 0);
+        }
+        while (::recv(fd, buf, sizeof buf, 0) > 0)
+        {
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int batch = argc > 1 ? atoi(argv[1]) : UdpServer::kMaxBatch;
+    bool gso = argc > 2;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(9984);
+    UdpServer server(&loop, listenAddr, "UdpBench");
+    server.setBatchSize(batch);
+    if (gso)
+    {
+        server.setGro(true);
+    }
+    long datagrams = 0;
+    server.setMessageCallback([&](UdpServer *s, const char *data, size_t len, const InetAddress &peer, Timestamp) {
+        ++datagrams;
+        if (gso)
+        {
+            // 同一个 GRO 缓冲切出来的数据报是相邻的 这里简化为每 kClientBatch 个回一次整块
+            if (datagrams % kClientBatch == 0)
+            {
+                std::string reply(kPayload * kClientBatch, 'r');
+                s->sendSegments(reply.data(), reply.size(), kPayload, peer);
+            }
+        }
+        else
+        {
+            s->sendTo(data, len, peer);
+        }
+    });
+    server.start();
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        runClient(listenAddr, gso);
+        ::_exit(0);
+    }
+    double cpuStart = cpuSeconds();
+    std::thread timer([&] {
+        ::sleep(kSeconds);
+        loop.quit();
+    });
+    loop.loop();
+    timer.join();
+    double cpu = cpuSeconds() - cpuStart;
+    ::kill(child, SIGKILL);
+    ::waitpid(child, nullptr, 0);
+    printf("batch %2d%s: %.0f datagrams/s, server cpu %.0f ns/datagram\n", batch, gso ? " gso/gro" : "",
+           datagrams / static_cast<double>(kSeconds), cpu * 1e9 / datagrams);
+}
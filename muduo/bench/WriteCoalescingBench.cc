@@ -0,0 +1,110 @@
+// 流水线的小请求 客户端一次写 kPipeline 个 "PING\n" 服务端每解析一行回一个 "PONG\n"
+// 对比每个 send 直接 write 和本轮末尾合并写 服务端每个请求的写系统调用数取自 /proc/self/io 的 syscw
+// ./WriteCoalescingBench && ./WriteCoalescingBench coalesce
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const int kConnections = 16;
+const int kPipeline = 16;
+const int kRounds = 5000;
+
+static long writeSyscalls()
+{
+    long syscw = 0;
+    FILE *fp = ::fopen("/proc/self/io", "r");
+    char line[128];
+    while (::fgets(line, sizeof line, fp))
+    {
+        ::sscanf(line, "syscw: %ld", &syscw);
+    }
+    ::fclose(fp);
+    return syscw;
+}
+
+// 客户端在子进程中运行 不计入服务端的 syscw
+static void runClients(const InetAddress &serverAddr)
+{
+    std::string request;
+    for (int i = 0; i < kPipeline; ++i)
+    {
+        request += "PING\n";
+    }
+    std::vector<int> fds;
+    for (int i = 0; i < kConnections; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(fd, (sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+        fds.push_back(fd);
+    }
+    char buf[4096];
+    for (int round = 0; round < kRounds; ++round)
+    {
+        for (int fd : fds)
+        {
+            ::write(fd, request.data(), request.size());
+        }
+        for (int fd : fds)
+        {
+            size_t received = 0;
+            while (received < request.size())
+            {
+                received += ::read(fd, buf, sizeof buf);
+            }
+        }
+    }
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool coalesce = argc > 1;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    InetAddress listenAddr(9988);
+    TcpServer server(&loop, listenAddr, "CoalesceBench");
+    TcpServer::Options options;
+    options.tcpNoDelay = true;
+    options.writeCoalescing = coalesce;
+    server.setOptions(options);
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        const char *eol;
+        while ((eol = static_cast<const char *>(::memchr(buf->peek(), '\n', buf->readableBytes()))) != nullptr)
+        {
+            buf->retrieve(eol + 1 - buf->peek());
+            conn->send("PONG\n", 5);
+        }
+    });
+    server.start();
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        runClients(listenAddr);
+        ::_exit(0);
+    }
+
+    long syscwStart = writeSyscalls();
+    auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&] {
+        ::waitpid(child, nullptr, 0);
+        loop.quit();
+    });
+    loop.loop();
+    waiter.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long requests = static_cast<long>(kConnections) * kPipeline * kRounds;
+    printf("%s: %.0f requests/s, %.3f write syscalls/request\n", coalesce ? "coalesced" : "direct",
+           requests / seconds, static_cast<double>(writeSyscalls() - syscwStart) / requests);
+}
@@ -0,0 +1,95 @@
+// loopback 上对比 send 和 sendZeroCopy 每种块大小发 1GB 写完一批再发下一批 服务端 CPU 取自 getrusage
+// loopback 上内核总会在接收端拷贝(SO_EE_CODE_ZEROCOPY_COPIED) 连接收到第一个这样的通知后退回普通 send
+// ./ZeroCopyBench && ./ZeroCopyBench zerocopy
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include "TcpServer.h"
+#include "Logger.h"
+
+const size_t kTotal = 1UL << 30;
+const int kBlocksPerBatch = 4;
+
+static double cpuSeconds()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void receive(const InetAddress &serverAddr)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::connect(fd, (sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+    std::unique_ptr<char[]> buf(new char[1024 * 1024]);
+    size_t received = 0;
+    ssize_t n;
+    while (received < kTotal && (n = ::read(fd, buf.get(), 1024 * 1024)) > 0)
+    {
+        received += n;
+    }
+    ::close(fd);
+}
+
+static void runOnce(size_t blockSize, bool zeroCopy)
+{
+    EventLoop loop;
+    InetAddress listenAddr(9987);
+    TcpServer server(&loop, listenAddr, "ZeroCopyBench");
+    ChainBuffer::Block block = std::make_shared<const std::string>(blockSize, 'z');
+    size_t sent = 0;
+    auto sendBatch = [&](const TcpConnectionPtr &conn) {
+        for (int i = 0; i < kBlocksPerBatch && sent < kTotal; ++i, sent += blockSize)
+        {
+            if (zeroCopy)
+            {
+                conn->sendZeroCopy(block);
+            }
+            else
+            {
+                conn->send(block->data(), block->size());
+            }
+        }
+    };
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            sendBatch(conn);
+        }
+    });
+    server.setWriteCompleteCallback(sendBatch);
+    server.start();
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        receive(listenAddr);
+        ::_exit(0);
+    }
+    double cpuStart = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&] {
+        ::waitpid(child, nullptr, 0);
+        loop.quit();
+    });
+    loop.loop();
+    waiter.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s %7zu B blocks: %5.0f MB/s, server cpu %.3f s\n", zeroCopy ? "sendZeroCopy" : "send        ",
+           blockSize, (kTotal >> 20) / seconds, cpuSeconds() - cpuStart);
+}
+
+int main(int argc, char *argv[])
+{
+    bool zeroCopy = argc > 1;
+    Logger::setLogLevel(ERROR);
+    for (size_t blockSize : {4096, 16384, 65536, 262144, 1048576})
+    {
+        runOnce(blockSize, zeroCopy);
+    }
+}
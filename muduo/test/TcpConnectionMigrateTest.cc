@@ -0,0 +1,136 @@
+// 另一个线程不停地 send 递增的序号 同时反复把连接迁到别的 loop 上 客户端检查收到的序号没有乱序或丢失
+// ./TcpConnectionMigrateTest
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19527;
+static const uint32_t kMessages = 200000;
+
+static std::mutex g_mutex;
+static std::condition_variable g_cond;
+static TcpConnectionPtr g_conn;
+
+static bool readFull(int fd, char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, buf, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+int main()
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "MigrateTest");
+    server.setThreadNum(3);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            g_conn = conn;
+            g_cond.notify_all();
+        }
+    });
+    server.start();
+    std::vector<EventLoop *> loops = server.getAllLoops();
+
+    int failures = 0;
+    std::atomic<int> migrations(0);
+    std::thread client([&]() {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = *InetAddress(kPort).getSockAddr();
+        if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            perror("connect");
+            ++failures;
+            loop.quit();
+            return;
+        }
+        TcpConnectionPtr conn;
+        {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            g_cond.wait(lock, []() { return g_conn != nullptr; });
+            conn = g_conn;
+        }
+
+        std::atomic_bool sending(true);
+        std::thread sender([&]() {
+            for (uint32_t i = 0; i < kMessages; ++i)
+            {
+                uint32_t seq = htonl(i);
+                conn->send(reinterpret_cast<const char *>(&seq), sizeof seq);
+                if (i % 100 == 0)
+                {
+                    ::usleep(10);    // 让迁移穿插在发送之间
+                }
+            }
+            sending = false;
+        });
+        std::thread migrator([&]() {
+            size_t next = 0;
+            while (sending)
+            {
+                EventLoop *target = loops[next++ % loops.size()];
+                conn->getLoop()->runInLoop([conn, target, &migrations]() {
+                    if (conn->migrateTo(target))
+                    {
+                        ++migrations;
+                    }
+                });
+                ::usleep(50);
+            }
+        });
+
+        for (uint32_t i = 0; i < kMessages; ++i)
+        {
+            uint32_t seq = 0;
+            if (!readFull(fd, reinterpret_cast<char *>(&seq), sizeof seq))
+            {
+                printf("connection closed after %u messages\n", i);
+                ++failures;
+                break;
+            }
+            if (ntohl(seq) != i)
+            {
+                printf("expected %u got %u\n", i, ntohl(seq));
+                ++failures;
+                break;
+            }
+        }
+        sender.join();
+        migrator.join();
+        ::close(fd);
+        {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            g_conn.reset();
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    printf("%d migrations\n", migrations.load());
+    if (migrations == 0)
+    {
+        printf("connection never migrated\n");
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// 客户端一直收发的同时反复缩容扩容 缩容的迁移还没完成就接着缩容 检查每个连接都还能回显
+// ./TcpServerResizeTest
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+#include "TcpServer.h"
+#include "Logger.h"
+
+static const uint16_t kPort = 19528;
+static const int kConnections = 64;
+static const int kRounds = 200;
+
+static bool echo(int fd, int round)
+{
+    char out[16];
+    char in[sizeof out];
+    snprintf(out, sizeof out, "%015d", round);
+    if (::write(fd, out, sizeof out) != sizeof out)
+    {
+        return false;
+    }
+    size_t got = 0;
+    while (got < sizeof in)
+    {
+        ssize_t n = ::read(fd, in + got, sizeof in - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return memcmp(in, out, sizeof out) == 0;
+}
+
+int main()
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ResizeTest");
+    server.setThreadNum(4);
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    int failures = 0;
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < kConnections; ++i)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr = *InetAddress(kPort).getSockAddr();
+            timeval timeout = {5, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+            if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+            {
+                perror("connect");
+                ++failures;
+                break;
+            }
+            fds.push_back(fd);
+        }
+
+        // 连着发起两次缩容 第二次摘除的 loop 可能正是第一次迁移的目标
+        const int sizes[] = {2, 1, 4, 4, 3, 0, 4, 4};
+        for (int round = 0; round < kRounds && failures == 0; ++round)
+        {
+            server.resize(sizes[round % 4 * 2]);
+            server.resize(sizes[round % 4 * 2 + 1]);
+            for (size_t i = 0; i < fds.size(); ++i)
+            {
+                if (!echo(fds[i], round))
+                {
+                    printf("round %d connection %zu no echo\n", round, i);
+                    ++failures;
+                    break;
+                }
+            }
+        }
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return failures == 0 ? 0 : 1;
+}